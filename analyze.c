@@ -0,0 +1,641 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2008 Tord Romstad (Glaurung author)
+  Copyright (C) 2008-2015 Marco Costalba, Joona Kiiski, Tord Romstad
+  Copyright (C) 2015-2018 Marco Costalba, Joona Kiiski, Gary Linscott, Tord Romstad
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#endif
+
+#include "analyze.h"
+#include "misc.h"
+#include "movegen.h"
+#include "position.h"
+#include "search.h"
+#include "settings.h"
+#include "tbprobe.h"
+#include "thread.h"
+#include "tt.h"
+#include "uci.h"
+
+// The work queue is shared by all workers. Each worker takes the next
+// position from it and adds its nodes to the total.
+
+typedef struct {
+  atomic_int next;
+  atomic_uint_fast64_t nodes;
+} WorkQueue;
+
+static WorkQueue *queue;
+static char **lines;
+static int numLines;
+static int outFd = -1;
+
+// In solve mode each worker stores the outcome of its positions in a shared
+// array, from which the summary table is printed at the end.
+
+typedef struct {
+  char id[32];
+  bool solved;
+  Move best;
+  Depth depth;
+  TimePoint time;
+  uint64_t nodes;
+} SolveResult;
+
+static SolveResult *results;
+static int solveStable;
+
+// read_lines() reads the non-empty lines of a FEN or EPD file that are not
+// comments.
+
+static bool read_lines(const char *file)
+{
+  FILE *F = fopen(file, "r");
+  if (!F) {
+    fprintf(stderr, "Unable to open file %s\n", file);
+    return false;
+  }
+
+  int maxLines = 100;
+  lines = malloc(maxLines * sizeof(char *));
+  numLines = 0;
+  char *buf = NULL;
+  size_t size = 0;
+  while (getline(&buf, &size, F) > 0) {
+    buf[strcspn(buf, "\r\n")] = 0;
+    if (!*buf || *buf == '#')
+      continue;
+    if (numLines == maxLines) {
+      maxLines *= 2;
+      lines = realloc(lines, maxLines * sizeof(char *));
+    }
+    lines[numLines++] = strdup(buf);
+  }
+  free(buf);
+  fclose(F);
+
+  return true;
+}
+
+static void free_lines(void)
+{
+  for (int i = 0; i < numLines; i++)
+    free(lines[i]);
+  free(lines);
+}
+
+// epd_to_fen() turns a FEN line or an EPD record into a 'position fen'
+// argument in the buffer cmd of the given size. EPD records lack the move
+// counters, which are then set to "0 1". It returns the EPD operations, or
+// an empty string, and NULL if the position does not fit in cmd.
+
+static const char *epd_to_fen(const char *line, char *cmd, size_t size)
+{
+  const char *p = line;
+  size_t n = strlen(strcpy(cmd, "fen"));
+  int fields = 0;
+
+  while (fields < 6) {
+    p += strspn(p, " \t");
+    size_t len = strcspn(p, " \t");
+    if (!len || (fields >= 4 && strspn(p, "0123456789") < len))
+      break;
+    // Leave room for the move counters that may be appended
+    if (n + 1 + len + sizeof(" 0 1") > size)
+      return NULL;
+    cmd[n++] = ' ';
+    memcpy(cmd + n, p, len);
+    cmd[n += len] = 0;
+    p += len;
+    fields++;
+  }
+  strcat(cmd, fields == 4 ? " 0 1" : fields == 5 ? " 1" : "");
+
+  return p + strspn(p, " \t");
+}
+
+// move_to_san() writes legal move m in SAN without check marks, '=' and
+// dashes, so that it can be compared to a normalised 'bm' or 'am' operand.
+
+static void move_to_san(const Position *pos, Move m, ExtMove *list,
+                        ExtMove *last, char *str)
+{
+  Square from = from_sq(m), to = to_sq(m);
+  int pt = type_of_p(piece_on(from));
+
+  if (type_of_m(m) == CASTLING) {
+    strcpy(str, to > from ? "OO" : "OOO");
+    return;
+  }
+
+  if (pt != PAWN) {
+    *str++ = PieceToChar[pt];
+    bool other = false, sameFile = false, sameRank = false;
+    for (ExtMove *e = list; e < last; e++) {
+      Square s = from_sq(e->move);
+      if (   s != from && to_sq(e->move) == to
+          && type_of_m(e->move) != CASTLING
+          && type_of_p(piece_on(s)) == pt)
+      {
+        other = true;
+        sameFile |= file_of(s) == file_of(from);
+        sameRank |= rank_of(s) == rank_of(from);
+      }
+    }
+    if (other && (!sameFile || sameRank))
+      *str++ = 'a' + file_of(from);
+    if (other && sameFile)
+      *str++ = '1' + rank_of(from);
+  } else if (is_capture(pos, m))
+    *str++ = 'a' + file_of(from);
+
+  if (is_capture(pos, m))
+    *str++ = 'x';
+  *str++ = 'a' + file_of(to);
+  *str++ = '1' + rank_of(to);
+  if (type_of_m(m) == PROMOTION)
+    *str++ = PieceToChar[promotion_type(m)];
+  *str = 0;
+}
+
+// san_to_move() converts a move in SAN or in coordinate notation to a legal
+// move in the current position. It returns 0 if there is no such move.
+
+static Move san_to_move(const Position *pos, const char *san)
+{
+  char buf[16], norm[16];
+  int n = 0;
+
+  strncpy(buf, san, 15);
+  buf[15] = 0;
+  Move m = uci_to_move(pos, buf);
+  if (m)
+    return m;
+
+  for (; *san && n < 15; san++)
+    if (!strchr("+#!?=-", *san))
+      norm[n++] = *san == '0' ? 'O' : *san;
+  norm[n] = 0;
+
+  ExtMove list[MAX_MOVES];
+  ExtMove *last = generate_legal(pos, list);
+  for (ExtMove *e = list; e < last; e++) {
+    move_to_san(pos, e->move, list, last, buf);
+    if (strcmp(buf, norm) == 0)
+      return e->move;
+  }
+
+  return 0;
+}
+
+// parse_epd_ops() sets the solutions of the search limits from the 'bm' or
+// 'am' operation of an EPD record and copies its 'id' to id.
+
+static void parse_epd_ops(const Position *pos, const char *ops, char *id)
+{
+  char opcode[16], operand[64];
+
+  Limits.numSolutions = 0;
+  while (*ops) {
+    ops += strspn(ops, " \t;");
+    size_t len = strcspn(ops, " \t;");
+    if (!len)
+      break;
+    snprintf(opcode, sizeof(opcode), "%.*s", (int)len, ops);
+    ops += len;
+
+    // Read the operands up to the ';' that ends the operation
+    while (*ops && *ops != ';') {
+      ops += strspn(ops, " \t");
+      if (*ops == '"') {
+        len = strcspn(++ops, "\"");
+        snprintf(operand, sizeof(operand), "%.*s", (int)len, ops);
+        ops += len + (ops[len] == '"');
+      } else {
+        len = strcspn(ops, " \t;");
+        snprintf(operand, sizeof(operand), "%.*s", (int)len, ops);
+        ops += len;
+      }
+      if (!*operand)
+        continue;
+
+      if (strcmp(opcode, "id") == 0)
+        snprintf(id, sizeof(results[0].id), "%.*s",
+                 (int)sizeof(results[0].id) - 1, operand);
+      else if (   (strcmp(opcode, "bm") == 0 || strcmp(opcode, "am") == 0)
+               && Limits.numSolutions < 8)
+      {
+        Move m = san_to_move(pos, operand);
+        if (m) {
+          Limits.solutions[Limits.numSolutions++] = m;
+          Limits.avoidSolutions = opcode[0] == 'a';
+        }
+      }
+    }
+  }
+}
+
+// emit() writes a result line in one go, so that the lines of concurrent
+// workers do not interleave.
+
+static void emit(const char *str)
+{
+#ifndef _WIN32
+  if (outFd >= 0) {
+    size_t len = strlen(str);
+    while (len > 0) {
+      ssize_t n = write(outFd, str, len);
+      if (n <= 0)
+        break;
+      str += n, len -= n;
+    }
+    return;
+  }
+#endif
+  fputs(str, stdout);
+  fflush(stdout);
+}
+
+// search_position() sets up and searches position i with the given limit.
+// It returns false without searching if the record is too long.
+
+static bool search_position(Position *pos, int i, int limit,
+                            const char *limitType)
+{
+  char cmd[256];
+
+  Limits = (struct LimitsType){ 0 };
+  Limits.startTime = now();
+
+  const char *ops = epd_to_fen(lines[i], cmd, sizeof(cmd));
+  if (!ops)
+    return false;
+  position(pos, cmd);
+
+  if (solveStable) {
+    Limits.solveStable = solveStable;
+    sprintf(results[i].id, "%d", i + 1);
+    parse_epd_ops(pos, ops, results[i].id);
+  }
+  if (strcmp(limitType, "nodes") == 0)
+    Limits.nodes = limit;
+  else if (strcmp(limitType, "movetime") == 0)
+    Limits.movetime = limit;
+  else
+    Limits.depth = limit;
+  Limits.startTime = now();
+  start_thinking(pos, false);
+  thread_wait_until_sleeping(threads_main());
+
+  return true;
+}
+
+// record_solution() stores the outcome of solving position i. The time and
+// nodes to solution are those at the start of the final run of iterations
+// in which a solution was the best move.
+
+static void record_solution(int i, Move best, Depth depth, uint64_t nodes)
+{
+  SolveResult *r = &results[i];
+
+  r->best = best;
+  r->depth = depth;
+  r->solved = Limits.numSolutions && is_solution(best);
+  r->time = now() - Limits.startTime;
+  r->nodes = nodes;
+  if (r->solved && mainThread.solveIters) {
+    r->time = mainThread.solveTime;
+    r->nodes = mainThread.solveNodes;
+  }
+}
+
+// append() appends formatted text at offset *n of the buffer buf of the
+// given size. Text that does not fit is cut off.
+
+static void append(char *buf, size_t size, size_t *n, const char *fmt, ...)
+{
+  va_list args;
+
+  va_start(args, fmt);
+  int len = vsnprintf(buf + *n, size - *n, fmt, args);
+  va_end(args);
+  if (len > 0)
+    *n = min(*n + len, size - 1);
+}
+
+// analyze_worker() searches positions from the queue until it is empty and
+// reports each result as soon as it is known.
+
+static void analyze_worker(Position *pos, int limit, const char *limitType)
+{
+  char buf[16], line[256 + 6 * MAX_PLY];
+  int i;
+
+  while ((i = atomic_fetch_add(&queue->next, 1)) < numLines) {
+    if (!search_position(pos, i, limit, limitType)) {
+      if (solveStable) {
+        snprintf(results[i].id, sizeof(results[0].id), "%d", i + 1);
+        record_solution(i, 0, 0, 0);
+      } else {
+        snprintf(line, sizeof(line), "%d info string Record too long\n", i + 1);
+        emit(line);
+      }
+      continue;
+    }
+
+    Position *p = threads_main();
+    RootMove *rm = &p->rootMoves->move[0];
+    uint64_t nodes = threads_nodes_searched();
+    int chess960 = option_value(OPT_CHESS960);
+
+    atomic_fetch_add(&queue->nodes, nodes);
+
+    if (solveStable) {
+      record_solution(i, rm->pv[0], p->completedDepth, nodes);
+      continue;
+    }
+
+    // Keep room for the newline
+    size_t n = 0, size = sizeof(line) - 1;
+    append(line, size, &n, "%d bestmove %s", i + 1,
+           uci_move(buf, rm->pv[0], chess960));
+    // Report the tablebase score unless the search found a mate
+    Value v =  TB_RootInTB && abs(rm->score) < VALUE_MATE_IN_MAX_PLY
+             ? rm->tbScore : rm->score;
+    append(line, size, &n, " score %s", uci_value(buf, v));
+    append(line, size, &n, " depth %d nodes %" PRIu64 " tbhits %" PRIu64
+           " time %" PRId64 " pv", p->completedDepth, nodes,
+           threads_tb_hits(), (now() - Limits.startTime) / 1000);
+    for (int k = 0; k < rm->pvSize; k++)
+      append(line, size, &n, " %s", uci_move(buf, rm->pv[k], chess960));
+    strcpy(line + n, "\n");
+    emit(line);
+  }
+}
+
+#ifndef _WIN32
+
+// worker_clear() gives a worker a fresh search state. A table mapped from
+// the Hash File is shared by all workers and keeps its contents. Otherwise
+// the worker swaps the copy-on-write table it inherited for one of its own
+// of Hash / workers, so that clearing it does not copy the full table into
+// every worker.
+
+static void worker_clear(int workers)
+{
+  if (!TT.header) {
+    delayedSettings.ttSize = max(settings.ttSize / workers, 64);
+    delayedSettings.ttFile[0] = 0;
+  }
+
+  // search_clear() then leaves the table alone: a new one was cleared when
+  // it was allocated and a shared one is kept
+  delayedSettings.clear = true;
+  process_delayed_settings();
+}
+
+#endif
+
+// run_workers() lets the workers search all positions and returns the time
+// it took, or 0 if the workers could not be started. Each worker is a
+// process with its own search state.
+
+static TimePoint run_workers(Position *pos, int workers, int limit,
+                             const char *limitType)
+{
+  process_delayed_settings();
+
+  TimePoint elapsed = now();
+
+#ifndef _WIN32
+  queue = mmap(NULL, sizeof(WorkQueue), PROT_READ | PROT_WRITE,
+               MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (queue == MAP_FAILED) {
+    fprintf(stderr, "Unable to share the work queue.\n");
+    queue = NULL;
+    return 0;
+  }
+  atomic_init(&queue->next, 0);
+  atomic_init(&queue->nodes, 0);
+
+  fflush(stdout);
+  for (int w = 0; w < workers; w++)
+    if (fork() == 0) {
+      // Send the results to the real stdout and the 'bestmove' lines of
+      // the search to /dev/null. The search thread does not survive fork().
+      int devNull = open("/dev/null", O_WRONLY);
+      outFd = dup(1);
+      dup2(devNull, 1);
+      close(devNull);
+      threads_init();
+      worker_clear(workers);
+      analyze_worker(pos, limit, limitType);
+      threads_exit();
+      exit(EXIT_SUCCESS);
+    }
+  for (int w = 0; w < workers; w++)
+    wait(NULL);
+#else
+  static WorkQueue q;
+  queue = &q;
+  atomic_init(&queue->next, 0);
+  atomic_init(&queue->nodes, 0);
+  search_clear();
+  analyze_worker(pos, limit, limitType);
+#endif
+
+  return now() - elapsed + 1; // Ensure positivity to avoid a 'divide by zero'
+}
+
+// parse_args() reads the optional limit, limit type, number of stable
+// iterations (solve only) and number of workers that follow the file name.
+
+static void parse_args(int *limit, char **limitType, int *stable,
+                       int *workers)
+{
+  char *token;
+
+#ifndef _WIN32
+  *workers = sysconf(_SC_NPROCESSORS_ONLN);
+#else
+  *workers = 1;
+#endif
+
+  if (!(token = strtok(NULL, " \t")))
+    return;
+  *limit = atoi(token);
+  if (!(token = strtok(NULL, " \t")))
+    return;
+  *limitType = token;
+  if (stable) {
+    if (!(token = strtok(NULL, " \t")))
+      return;
+    *stable = max(atoi(token), 1);
+  }
+  if ((token = strtok(NULL, " \t")))
+    *workers = atoi(token);
+}
+
+// analyze() searches all positions of a FEN or EPD file and writes one
+// line per position, tagged with its number in the file, as soon as it is
+// done. The parameters are:
+// - file name
+// - limit value (default 13)
+// - limit type: depth (default), nodes or movetime
+// - number of workers (default: number of CPUs)
+// A summary is printed to stderr at the end.
+
+void analyze(Position *pos, char *str)
+{
+  char *file = strtok(str, " \t");
+  char *limitType = "depth";
+  int limit = 13, workers;
+
+  if (!file) {
+    fprintf(stderr, "Usage: analyze <file> [limit] [depth|nodes|movetime] [workers]\n");
+    return;
+  }
+  parse_args(&limit, &limitType, NULL, &workers);
+  if (!read_lines(file))
+    return;
+
+  workers = clamp(workers, 1, max(numLines, 1));
+  solveStable = 0;
+  TimePoint elapsed = run_workers(pos, workers, limit, limitType);
+  if (!elapsed) {
+    free_lines();
+    return;
+  }
+  uint64_t nodes = atomic_load(&queue->nodes);
+
+  fprintf(stderr, "\n==========================="
+                  "\nPositions       : %d"
+                  "\nWorkers         : %d"
+                  "\nTotal time (ms) : %" PRIu64
+                  "\nNodes searched  : %" PRIu64
+                  "\nNodes/second    : %" PRIu64
+                  "\nPositions/second: %.2f\n",
+                  numLines, workers, (uint64_t)elapsed / 1000, nodes,
+                  1000000 * nodes / elapsed, 1e6 * numLines / elapsed);
+
+#ifndef _WIN32
+  munmap(queue, sizeof(WorkQueue));
+#endif
+  free_lines();
+}
+
+// solve() runs the positions of an EPD test suite with 'bm' or 'am'
+// operations until a solution has been the best move for a number of
+// completed iterations, or the limit is hit. It prints a table with the
+// time and nodes to solution of each position and the totals. The
+// parameters are:
+// - file name
+// - limit value (default 10000)
+// - limit type: movetime (default), nodes or depth
+// - number of iterations a solution must stay best (default 3)
+// - number of workers (default: number of CPUs)
+
+void solve(Position *pos, char *str)
+{
+  char *file = strtok(str, " \t");
+  char *limitType = "movetime";
+  int limit = 10000, stable = 3, workers;
+  char buf[16];
+
+  if (!file) {
+    fprintf(stderr, "Usage: solve <file> [limit] [movetime|nodes|depth] [stable] [workers]\n");
+    return;
+  }
+  parse_args(&limit, &limitType, &stable, &workers);
+  if (!read_lines(file))
+    return;
+
+  workers = clamp(workers, 1, max(numLines, 1));
+#ifndef _WIN32
+  results = mmap(NULL, max(numLines, 1) * sizeof(SolveResult),
+                 PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (results == MAP_FAILED)
+    results = NULL;
+#else
+  results = calloc(max(numLines, 1), sizeof(SolveResult));
+#endif
+  if (!results) {
+    fprintf(stderr, "Unable to allocate the results.\n");
+    free_lines();
+    return;
+  }
+  solveStable = stable;
+  TimePoint elapsed = run_workers(pos, workers, limit, limitType);
+  if (!elapsed) {
+#ifndef _WIN32
+    munmap(results, max(numLines, 1) * sizeof(SolveResult));
+#else
+    free(results);
+#endif
+    solveStable = 0;
+    free_lines();
+    return;
+  }
+  uint64_t nodes = atomic_load(&queue->nodes);
+
+  int solved = 0;
+  TimePoint solveTime = 0;
+  uint64_t solveNodes = 0;
+
+  printf("\n  #  %-20s %-8s %-7s %5s %10s %12s\n",
+         "id", "result", "move", "depth", "time (ms)", "nodes");
+  for (int i = 0; i < numLines; i++) {
+    SolveResult *r = &results[i];
+    printf("%3d  %-20.20s %-8s %-7s %5d %10" PRId64 " %12" PRIu64 "\n",
+           i + 1, r->id, r->solved ? "solved" : "failed",
+           uci_move(buf, r->best, option_value(OPT_CHESS960)), r->depth,
+           r->time / 1000, r->nodes);
+    if (r->solved) {
+      solved++;
+      solveTime += r->time;
+      solveNodes += r->nodes;
+    }
+  }
+  printf("\n==========================="
+         "\nSolved          : %d/%d"
+         "\nWorkers         : %d"
+         "\nTime to solve   : %" PRId64 " ms"
+         "\nNodes to solve  : %" PRIu64
+         "\nTotal time (ms) : %" PRIu64
+         "\nNodes searched  : %" PRIu64 "\n",
+         solved, numLines, workers, solveTime / 1000, solveNodes,
+         (uint64_t)elapsed / 1000, nodes);
+  fflush(stdout);
+
+#ifndef _WIN32
+  munmap(results, max(numLines, 1) * sizeof(SolveResult));
+  munmap(queue, sizeof(WorkQueue));
+#else
+  free(results);
+#endif
+  solveStable = 0;
+  free_lines();
+}
@@ -0,0 +1,9 @@
+#ifndef ANALYZE_H
+#define ANALYZE_H
+
+#include "types.h"
+
+void analyze(Position *pos, char *str);
+void solve(Position *pos, char *str);
+
+#endif
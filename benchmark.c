@@ -0,0 +1,186 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2008 Tord Romstad (Glaurung author)
+  Copyright (C) 2008-2015 Marco Costalba, Joona Kiiski, Tord Romstad
+  Copyright (C) 2015-2018 Marco Costalba, Joona Kiiski, Gary Linscott, Tord Romstad
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "benchmark.h"
+#include "misc.h"
+#include "position.h"
+#include "search.h"
+#include "settings.h"
+#include "thread.h"
+#include "uci.h"
+
+static const char *Defaults[] = {
+  "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+  "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 10",
+  "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 11",
+  "4rrk1/pp1n3p/3q2pQ/2p1pb2/2PP4/2P3N1/P2B2PP/4RRK1 b - - 7 19",
+  "rq3rk1/ppp2ppp/1bnpb3/3N2B1/3NP3/7P/PPPQ1PP1/2KR3R w - - 7 14",
+  "r1bq1r1k/1pp1n1pp/1p1p4/4p2Q/4Pp2/1BNP4/PPP2PPP/3R1RK1 w - - 2 14",
+  "r3r1k1/2p2ppp/p1p1bn2/8/1q2P3/2NPQN2/PPP3PP/R4RK1 b - - 2 15",
+  "r1bbk1nr/pp3p1p/2n5/1N4p1/2Np1B2/8/PPP2PPP/2KR1B1R w kq - 0 13",
+  "r1bq1rk1/ppp1nppp/4n3/3p3Q/3P4/1BP1B3/PP1N2PP/R4RK1 w - - 1 16",
+  "4r1k1/r1q2ppp/ppp2n2/4P3/5Rb1/1N1BQ3/PPP3PP/R5K1 w - - 1 17",
+  "2rqkb1r/ppp2p2/2npb1p1/1N1Nn2p/2P1PP2/8/PP2B1PP/R1BQK2R b KQ - 0 11",
+  "r1bq1r1k/b1p1npp1/p2p3p/1p6/3PP3/1B2NN2/PP3PPP/R2Q1RK1 w - - 1 16",
+  "3r1rk1/p5pp/bpp1pp2/8/q1PP1P2/b3P3/P2NQRPP/1R2B1K1 b - - 6 22",
+  "r1q2rk1/2p1bppp/2Pp4/p6b/Q1PNp3/4B3/PP1R1PPP/2K4R w - - 2 18",
+  "4k2r/1pb2ppp/1p2p3/1R1p4/3P4/2r1PN2/P4PPP/1R4K1 b - - 3 22",
+  "3q2k1/pb3p1p/4pbp1/2r5/PpN2N2/1P2P2P/5PP1/Q2R2K1 b - - 4 26",
+  "6k1/6p1/6Pp/ppp5/3pn2P/1P3K2/1PP2P2/3N4 b - - 0 1",
+  "3b4/5kp1/1p1p1p1p/pP1PpP1P/P1P1P3/3KN3/8/8 w - - 0 1",
+  "2K5/p7/7P/5pR1/8/5k2/r7/8 w - - 0 1",
+  "8/6pk/1p6/8/PP3p1p/5P2/4KP1q/3Q4 w - - 0 1",
+  "7k/3p2pp/4q3/8/4Q3/5Kp1/P6b/8 w - - 0 1",
+  "8/2p5/8/2kPKp1p/2p4P/2P5/3P4/8 w - - 0 1",
+  "8/1p3pp1/7p/5P1P/2k3P1/8/2K2P2/8 w - - 0 1",
+  "8/pp2r1k1/2p1p3/3pP2p/1P1P1P1P/P5KR/8/8 w - - 0 1",
+  "8/3p4/p1bk3p/Pp6/1Kp1PpPp/2P2P1P/2P5/5B2 b - - 0 1",
+  "5k2/7R/4P2p/5K2/p1r2P1p/8/8/8 b - - 0 1",
+  "6k1/6p1/P6p/r1N5/5p2/7P/1b3PP1/4R1K1 w - - 0 1",
+  "1r3k2/4q3/2Pp3b/3Bp3/2Q2p2/1p1P2P1/1P2KP2/3N4 w - - 0 1",
+  "6k1/4pp1p/3p2p1/P1pPb3/R7/1r2P1PP/3B1P2/6K1 w - - 0 1",
+  "8/3p3B/5p2/5P2/p7/PP5b/k7/6K1 w - - 0 1",
+  "8/8/8/8/5kp1/P7/8/1K1N4 w - - 0 1",
+  "8/8/8/5N2/8/p7/8/2NK3k w - - 0 1",
+  "8/3k4/8/8/8/4B3/4KB2/2B5 w - - 0 1",
+  "8/8/1P6/5pr1/8/4R3/7k/2K5 w - - 0 1",
+  "8/2p4P/8/kr6/6R1/8/8/1K6 w - - 0 1",
+  "8/8/3P3k/8/1p6/8/1P6/1K3n2 b - - 0 1",
+  "8/R7/2q5/8/6k1/8/1P5p/K6R w - - 0 124",
+  "6k1/3b3r/1p1p4/p1n2p2/1PPNpP1q/P3Q1p1/1R1RB1P1/5K2 b - - 0 1",
+  "r2r1n2/pp2bk2/2p1p2p/3q4/3PN1QP/2P3R1/P4PP1/5RK1 w - - 0 1",
+  "8/8/8/8/8/6k1/6p1/6K1 w - - 0 1",
+  "7k/7P/6K1/8/3B4/8/8/8 b - - 0 1"
+};
+
+// benchmark() runs a simple benchmark by letting the engine analyze a set
+// of positions for a given limit each. There are five optional parameters:
+// - hash table size in MB (default 16)
+// - number of threads (default 1)
+// - limit value (default 13)
+// - file name with one position in FEN format per line (default: built-in)
+// - limit type: depth (default), perft, nodes or movetime
+// The sum of the nodes searched and the speed are reported at the end.
+
+void benchmark(Position *current, char *str)
+{
+  char *token;
+  char **fens;
+  int numFens;
+
+  int ttSize = 16, threads = 1, limit = 13;
+  char *fenFile = NULL, *limitType = "depth";
+
+  if ((token = strtok(str, " \t"))) {
+    ttSize = atoi(token);
+    if ((token = strtok(NULL, " \t"))) {
+      threads = clamp(atoi(token), 1, MAX_THREADS);
+      if ((token = strtok(NULL, " \t"))) {
+        limit = atoi(token);
+        if ((token = strtok(NULL, " \t"))) {
+          fenFile = token;
+          if ((token = strtok(NULL, " \t")))
+            limitType = token;
+        }
+      }
+    }
+  }
+
+  delayedSettings.ttSize = (size_t)ttSize * 1024; // Hash is in kB
+  delayedSettings.numThreads = threads;
+  process_delayed_settings();
+  search_clear();
+
+  if (!fenFile || strcmp(fenFile, "default") == 0) {
+    numFens = sizeof(Defaults) / sizeof(*Defaults);
+    fens = malloc(numFens * sizeof(char *));
+    for (int i = 0; i < numFens; i++)
+      fens[i] = strdup(Defaults[i]);
+  } else {
+    FILE *F = fopen(fenFile, "r");
+    if (!F) {
+      fprintf(stderr, "Unable to open file %s\n", fenFile);
+      return;
+    }
+    int maxFens = 100;
+    fens = malloc(maxFens * sizeof(char *));
+    numFens = 0;
+    char buf[256];
+    while (fgets(buf, sizeof(buf), F)) {
+      // Skip the rest of a line that does not fit in the buffer
+      if (!strchr(buf, '\n') && !feof(F)) {
+        int c;
+        while ((c = fgetc(F)) != '\n' && c != EOF);
+      }
+      buf[strcspn(buf, "\r\n")] = 0;
+      if (!*buf)
+        continue;
+      if (numFens == maxFens) {
+        maxFens *= 2;
+        fens = realloc(fens, maxFens * sizeof(char *));
+      }
+      fens[numFens++] = strdup(buf);
+    }
+    fclose(F);
+  }
+
+  uint64_t nodes = 0;
+  TimePoint elapsed = now();
+
+  for (int i = 0; i < numFens; i++) {
+    char buf[sizeof("fen ") + 256];
+    snprintf(buf, sizeof(buf), "fen %s", fens[i]);
+    position(current, buf);
+
+    fprintf(stderr, "\nPosition: %d/%d\n", i + 1, numFens);
+
+    if (strcmp(limitType, "perft") == 0)
+      nodes += perft(current, limit);
+    else {
+      Limits = (struct LimitsType){ 0 };
+      if (strcmp(limitType, "nodes") == 0)
+        Limits.nodes = limit;
+      else if (strcmp(limitType, "movetime") == 0)
+        Limits.movetime = limit;
+      else
+        Limits.depth = limit;
+      Limits.startTime = now();
+      start_thinking(current, false);
+      thread_wait_until_sleeping(threads_main());
+      nodes += threads_nodes_searched();
+    }
+  }
+
+  elapsed = now() - elapsed + 1; // Ensure positivity to avoid a 'divide by zero'
+
+  fprintf(stderr, "\n==========================="
+                  "\nTotal time (ms) : %" PRIu64
+                  "\nNodes searched  : %" PRIu64
+                  "\nNodes/second    : %" PRIu64 "\n",
+                  (uint64_t)elapsed / 1000, nodes, 1000000 * nodes / elapsed);
+
+  for (int i = 0; i < numFens; i++)
+    free(fens[i]);
+  free(fens);
+}
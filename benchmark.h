@@ -0,0 +1,8 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include "types.h"
+
+void benchmark(Position *pos, char *str);
+
+#endif
@@ -23,8 +23,10 @@
 #include "bitboard.h"
 #include "endgame.h"
 #include "pawns.h"
+#include "polybook.h"
 #include "position.h"
 #include "search.h"
+#include "tbprobe.h"
 #include "thread.h"
 #include "tt.h"
 #include "uci.h"
@@ -46,6 +48,8 @@ int main(int argc, char **argv)
 
   threads_exit();
   options_free();
+  pb_free();
+  TB_free();
   tt_free();
   
   return 0;
@@ -224,6 +224,46 @@ const void *map_file(FD fd, map_t *map)
 #endif
 }
 
+// open_file_rw() opens a file for reading and writing, creating it if it
+// does not exist.
+
+FD open_file_rw(const char *name)
+{
+#ifndef _WIN32
+  return open(name, O_RDWR | O_CREAT, 0644);
+
+#else
+  return CreateFile(name, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL,
+      OPEN_ALWAYS, FILE_FLAG_RANDOM_ACCESS, NULL);
+
+#endif
+}
+
+// map_file_rw() resizes a file opened by open_file_rw() to size bytes and
+// maps it shared and writable, so that changes go back to the file.
+
+void *map_file_rw(FD fd, size_t size, map_t *map)
+{
+#ifndef _WIN32
+  if (file_size(fd) != size && ftruncate(fd, size) != 0)
+    return NULL;
+  *map = size;
+  void *data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+#ifdef MADV_RANDOM
+  madvise(data, size, MADV_RANDOM);
+#endif
+  return data == MAP_FAILED ? NULL : data;
+
+#else
+  *map = CreateFileMapping(fd, NULL, PAGE_READWRITE, (uint64_t)size >> 32,
+      (DWORD)size, NULL);
+  if (*map == NULL)
+    return NULL;
+  return MapViewOfFile(*map, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+
+#endif
+}
+
 void unmap_file(const void *data, map_t map)
 {
   if (!data) return;
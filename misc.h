@@ -27,7 +27,7 @@
 #include <pthread.h>
 #endif
 #include <stdatomic.h>
-#include <sys/time.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "types.h"
@@ -62,12 +62,23 @@ INLINE void prefetch2(void *addr)
   prefetch((uint8_t *)addr + 64);
 }
 
-typedef int64_t TimePoint; // A value in milliseconds
+typedef int64_t TimePoint; // A value in microseconds
+
+// now() reads a monotonic clock, so that short time controls are neither
+// rounded to whole milliseconds nor upset by changes of the wall clock.
 
 INLINE TimePoint now(void) {
-  struct timeval tv;
-  gettimeofday(&tv, NULL);
-  return 1000 * (uint64_t)tv.tv_sec + (uint64_t)tv.tv_usec / 1000;
+#ifndef _WIN32
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return 1000000 * (int64_t)ts.tv_sec + ts.tv_nsec / 1000;
+#else
+  LARGE_INTEGER cnt, freq;
+  QueryPerformanceCounter(&cnt);
+  QueryPerformanceFrequency(&freq);
+  return cnt.QuadPart / freq.QuadPart * 1000000
+       + cnt.QuadPart % freq.QuadPart * 1000000 / freq.QuadPart;
+#endif
 }
 
 #ifdef _WIN32
@@ -102,6 +113,8 @@ FD open_file(const char *name);
 void close_file(FD fd);
 size_t file_size(FD fd);
 const void *map_file(FD fd, map_t *map);
+FD open_file_rw(const char *name);
+void *map_file_rw(FD fd, size_t size, map_t *map);
 void unmap_file(const void *data, map_t map);
 void *allocate_memory(size_t size, bool lp, alloc_t *alloc);
 void free_memory(alloc_t *alloc);
@@ -45,7 +45,7 @@ INLINE ExtMove *make_promotions(ExtMove *list, Square to,
 
 
 INLINE ExtMove *generate_pawn_moves(const Position *pos, ExtMove *list,
-    Bitboard target, const Color Us, const int Type)
+    Bitboard target, Bitboard pinned, const Color Us, const int Type)
 {
   // Compute our parametrized parameters at compile time, named according to
   // the point of view of white side.
@@ -64,6 +64,7 @@ INLINE ExtMove *generate_pawn_moves(const Position *pos, ExtMove *list,
 
   Bitboard pawnsOn7    = pieces_cp(Us, PAWN) &  TRank7BB;
   Bitboard pawnsNotOn7 = pieces_cp(Us, PAWN) & ~TRank7BB;
+  ExtMove *first = list;
 
   // Single and double pawn pushes, no promotions
   if (Type != CAPTURES) {
@@ -76,12 +77,12 @@ INLINE ExtMove *generate_pawn_moves(const Position *pos, ExtMove *list,
     }
 
     if (Type == QUIET_CHECKS) {
-      Stack *st = pos->st;
+      Square ksq = check_info(pos->st)->ksq;
 
       // A quiet check is either a direct check or a discovered check.
-      Bitboard dcCandidatePawns = blockers_for_king(pos, Them) & ~file_bb_s(st->ksq);
-      b1 &= attacks_from_pawn(st->ksq, Them) | shift_bb(Up, dcCandidatePawns);
-      b2 &= attacks_from_pawn(st->ksq, Them) | shift_bb(Up+Up, dcCandidatePawns);
+      Bitboard dcCandidatePawns = blockers_for_king(pos, Them) & ~file_bb_s(ksq);
+      b1 &= attacks_from_pawn(ksq, Them) | shift_bb(Up, dcCandidatePawns);
+      b2 &= attacks_from_pawn(ksq, Them) | shift_bb(Up+Up, dcCandidatePawns);
     }
 
     while (b1) {
@@ -142,28 +143,49 @@ INLINE ExtMove *generate_pawn_moves(const Position *pos, ExtMove *list,
 
       assert(b1);
 
-      while (b1)
-        (list++)->move = make_enpassant(pop_lsb(&b1), ep_square());
+      // En passant captures can expose the king along the rank of the
+      // captured pawn, so they are tested in full.
+      while (b1) {
+        Move m = make_enpassant(pop_lsb(&b1), ep_square());
+        if (is_legal(pos, m))
+          (list++)->move = m;
+      }
     }
   }
 
+  // Pinned pawns may only move along the line through their king.
+  if (pinned & pieces_cp(Us, PAWN)) {
+    Square ksq = square_of(Us, KING);
+    while (first < list)
+      if ((pinned & sq_bb(from_sq(first->move))) && !aligned(first->move, ksq))
+        first->move = (--list)->move;
+      else
+        first++;
+  }
+
   return list;
 }
 
 
 INLINE ExtMove *generate_moves(const Position *pos, ExtMove *list,
-    Bitboard target, const Color Us, const int Pt, const bool Checks)
+    Bitboard target, Bitboard pinned, const Color Us, const int Pt,
+    const bool Checks)
 {
   assert(Pt != KING && Pt != PAWN);
 
-  Bitboard bb = pieces_cp(Us, Pt);
+  // A pinned knight can never move, a pinned slider only along the line
+  // through its king.
+  Bitboard bb = pieces_cp(Us, Pt) & (Pt == KNIGHT ? ~pinned : ~0ULL);
 
   while (bb) {
     Square from = pop_lsb(&bb);
     Bitboard b = attacks_bb(Pt, from, pieces()) & target;
 
+    if (Pt != KNIGHT && (pinned & sq_bb(from)))
+      b &= LineBB[square_of(Us, KING)][from];
+
     if (Checks && (Pt == QUEEN || !(blockers_for_king(pos, !Us) & sq_bb(from))))
-      b &= pos->st->checkSquares[Pt];
+      b &= check_info(pos->st)->checkSquares[Pt];
 
     while (b)
       (list++)->move = make_move(from, pop_lsb(&b));
@@ -178,6 +200,7 @@ INLINE ExtMove *generate_all(const Position *pos, ExtMove *list, const Color Us,
 {
   const bool Checks = Type == QUIET_CHECKS;
   const Square ksq = square_of(Us, KING);
+  Bitboard pinned = blockers_for_king(pos, Us) & pieces_c(Us);
   Bitboard target;
 
   if (Type == EVASIONS && more_than_one(checkers()))
@@ -187,11 +210,11 @@ INLINE ExtMove *generate_all(const Position *pos, ExtMove *list, const Color Us,
           : Type == NON_EVASIONS ? ~pieces_c(Us)
           : Type == CAPTURES     ? pieces_c(!Us) : ~pieces();
 
-  list = generate_pawn_moves(pos, list, target, Us, Type);
-  list = generate_moves(pos, list, target, Us, KNIGHT, Checks);
-  list = generate_moves(pos, list, target, Us, BISHOP, Checks);
-  list = generate_moves(pos, list, target, Us,   ROOK, Checks);
-  list = generate_moves(pos, list, target, Us,  QUEEN, Checks);
+  list = generate_pawn_moves(pos, list, target, pinned, Us, Type);
+  list = generate_moves(pos, list, target, pinned, Us, KNIGHT, Checks);
+  list = generate_moves(pos, list, target, pinned, Us, BISHOP, Checks);
+  list = generate_moves(pos, list, target, pinned, Us,   ROOK, Checks);
+  list = generate_moves(pos, list, target, pinned, Us,  QUEEN, Checks);
 
 kingMoves:
   if (!Checks || blockers_for_king(pos, !Us) & sq_bb(ksq)) {
@@ -199,17 +222,29 @@ kingMoves:
     if (Checks)
       b &= ~PseudoAttacks[QUEEN][square_of(!Us, KING)];
 
-    while (b)
-      (list++)->move = make_move(ksq, pop_lsb(&b));
+    // The king may not step onto an attacked square, including squares
+    // behind it on the line of a checking slider.
+    Bitboard occupied = pieces() ^ sq_bb(ksq);
+    while (b) {
+      Square to = pop_lsb(&b);
+      if (!(attackers_to_occ(pos, to, occupied) & pieces_c(!Us)))
+        (list++)->move = make_move(ksq, to);
+    }
 
     if ((Type == QUIETS || Type == NON_EVASIONS) && can_castle_c(Us)) {
       const int OO = make_castling_right(Us, KING_SIDE);
-      if (!castling_impeded(OO) && can_castle_cr(OO))
-        (list++)->move = make_castling(ksq, castling_rook_square(OO));
+      if (!castling_impeded(OO) && can_castle_cr(OO)) {
+        Move m = make_castling(ksq, castling_rook_square(OO));
+        if (is_legal(pos, m))
+          (list++)->move = m;
+      }
 
       const int OOO = make_castling_right(Us, QUEEN_SIDE);
-      if (!castling_impeded(OOO) && can_castle_cr(OOO))
-        (list++)->move = make_castling(ksq, castling_rook_square(OOO));
+      if (!castling_impeded(OOO) && can_castle_cr(OOO)) {
+        Move m = make_castling(ksq, castling_rook_square(OOO));
+        if (is_legal(pos, m))
+          (list++)->move = m;
+      }
     }
   }
 
@@ -217,19 +252,23 @@ kingMoves:
 }
 
 
-// generate_captures() generates all pseudo-legal captures plus queen and
-// checking knight promotions.
+// All generators produce legal moves only: pinned pieces are kept on their
+// pin lines, the king only moves to unattacked squares and castling and en
+// passant captures are tested in full.
 //
-// generate_quiets() generates all pseudo-legal non-captures and
-// underpromotions (except checking knight promotions).
+// generate_captures() generates all legal captures plus queen promotions.
+// Knight promotions, checking or not, are left to generate_quiets() with
+// the other underpromotions (see make_promotions()).
 //
-// generate_evasions() generates all pseudo-legal check evasions
+// generate_quiets() generates all legal non-captures and underpromotions,
+// including checking knight promotions.
 //
-// generate_quiet_checks() generates all pseudo-legal non-captures giving
-// check, except castling
+// generate_evasions() generates all legal check evasions
 //
-// generate_non_evasions() generates all pseudo-legal captures and
-// non-captures.
+// generate_quiet_checks() generates all legal non-captures giving check,
+// except castling
+//
+// generate_non_evasions() generates all legal captures and non-captures.
 
 INLINE ExtMove *generate(const Position *pos, ExtMove *list, const int Type)
 {
@@ -273,21 +312,6 @@ NOINLINE ExtMove *generate_non_evasions(const Position *pos, ExtMove *list)
 // generate_legal() generates all the legal moves in the given position
 NOINLINE ExtMove *generate_legal(const Position *pos, ExtMove *list)
 {
-  Color us = stm();
-  Bitboard pinned = blockers_for_king(pos, us) & pieces_c(us);
-  Square ksq = square_of(us, KING);
-  ExtMove *cur = list;
-
-  list = checkers() ? generate_evasions(pos, list)
+  return checkers() ? generate_evasions(pos, list)
                     : generate_non_evasions(pos, list);
-  while (cur != list)
-    if (  (  (pinned && pinned & sq_bb(from_sq(cur->move)))
-           || from_sq(cur->move) == ksq
-           || type_of_m(cur->move) == ENPASSANT)
-        && !is_legal(pos, cur->move))
-      cur->move = (--list)->move;
-    else
-      ++cur;
-
-  return list;
 }
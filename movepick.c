@@ -19,9 +19,16 @@
 */
 
 #include <assert.h>
+#include <inttypes.h>
+#include <stdio.h>
+#if defined(USE_AVX2) || defined(USE_SSE41)
+#include <immintrin.h>
+#endif
 
+#include "misc.h"
 #include "movepick.h"
 #include "thread.h"
+#include "tt.h"
 
 // An insertion sort which sorts moves in descending order up to and
 // including a given limit. The order of moves smaller than the limit is
@@ -40,17 +47,58 @@ INLINE void partial_insertion_sort(ExtMove *begin, ExtMove *end, int limit)
 }
 
 
-// pick_best() finds the best move in the range (begin, end).
+// max_value() returns the highest value in the range (begin, end). Moves
+// and values are interleaved, so with SIMD the move lanes are blended to
+// INT_MIN before taking the maximum. Short lists are scanned scalarly.
+
+INLINE int max_value(const ExtMove *begin, const ExtMove *end)
+{
+  const ExtMove *q = begin;
+  int best = INT_MIN;
+
+#if defined(USE_AVX2)
+  if (end - begin >= 8) {
+    const __m256i lo = _mm256_set1_epi32(INT_MIN);
+    __m256i vmax = lo;
+    for (; q + 4 <= end; q += 4)
+      vmax = _mm256_max_epi32(vmax, _mm256_blend_epi32(
+                        _mm256_loadu_si256((const __m256i *)q), lo, 0x55));
+    __m128i v = _mm_max_epi32(_mm256_castsi256_si128(vmax),
+                              _mm256_extracti128_si256(vmax, 1));
+    v = _mm_max_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+    best = _mm_extract_epi32(v, 1);
+  }
+#elif defined(USE_SSE41)
+  if (end - begin >= 4) {
+    const __m128i lo = _mm_set1_epi32(INT_MIN);
+    __m128i vmax = lo;
+    for (; q + 2 <= end; q += 2)
+      vmax = _mm_max_epi32(vmax, _mm_blend_epi16(
+                        _mm_loadu_si128((const __m128i *)q), lo, 0x33));
+    vmax = _mm_max_epi32(vmax, _mm_shuffle_epi32(vmax, _MM_SHUFFLE(1, 0, 3, 2)));
+    best = _mm_extract_epi32(vmax, 1);
+  }
+#endif
+
+  for (; q < end; q++)
+    if (q->value > best)
+      best = q->value;
+
+  return best;
+}
+
+
+// pick_best() finds the best move in the range (begin, end). Of several
+// moves with the same value the first one is picked.
 
 static Move pick_best(ExtMove *begin, ExtMove *end)
 {
-  ExtMove *p, *q;
+  int v = max_value(begin, end);
+  ExtMove *p = begin;
 
-  for (p = begin, q = begin + 1; q < end; q++)
-    if (q->value > p->value)
-      p = q;
+  while (p->value != v)
+    p++;
   Move m = p->move;
-  int v = p->value;
   *p = *begin;
   begin->value = v;
 
@@ -58,18 +106,30 @@ static Move pick_best(ExtMove *begin, ExtMove *end)
 }
 
 
+// prefetch_next() prefetches the TT cluster of the move that follows the
+// one being returned, in the stages that return moves in list order. The
+// cache miss then overlaps with the search of the current move.
+
+INLINE void prefetch_next(const Position *pos, const ExtMove *next,
+                          const ExtMove *end)
+{
+  if (next < end)
+    prefetch(tt_first_entry(key_after(pos, next->move)));
+}
+
+
 // score() assigns a numerical value to each move in a move list. The moves with
 // highest values will be picked first.
 
 static void score_captures(const Position *pos)
 {
-  Stack *st = pos->st;
+  MovePickerState *mp = picker(pos->st);
   CapturePieceToHistory *history = &captureHistory;
 
   // Winning and equal captures in the main search are ordered by MVV,
   // preferring captures near our with a good history.
 
-  for (ExtMove *m = st->cur; m < st->endMoves; m++)
+  for (ExtMove *m = mp->cur; m < mp->endMoves; m++)
     m->value =  PieceValue[MG][piece_on(to_sq(m->move))] * 6
               + (*history)[moved_piece(m->move)][to_sq(m->move)][type_of_p(piece_on(to_sq(m->move)))];
 }
@@ -78,6 +138,7 @@ SMALL
 static void score_quiets(const Position *pos)
 {
   Stack *st = pos->st;
+  MovePickerState *mp = picker(st);
   ButterflyHistory *history = &mainHistory;
 
   PieceToHistory *cmh = (st-1)->history;
@@ -87,7 +148,7 @@ static void score_quiets(const Position *pos)
 
   Color c = stm();
 
-  for (ExtMove *m = st->cur; m < st->endMoves; m++) {
+  for (ExtMove *m = mp->cur; m < mp->endMoves; m++) {
     uint32_t move = m->move & 4095;
     Square to = move & 63;
     Square from = move >> 6;
@@ -103,6 +164,7 @@ static void score_quiets(const Position *pos)
 static void score_evasions(const Position *pos)
 {
   Stack *st = pos->st;
+  MovePickerState *mp = picker(st);
   // Try captures ordered by MVV/LVA, then non-captures ordered by
   // stats heuristics.
 
@@ -110,7 +172,7 @@ static void score_evasions(const Position *pos)
   PieceToHistory *cmh = (st-1)->history;
   Color c = stm();
 
-  for (ExtMove *m = st->cur; m < st->endMoves; m++)
+  for (ExtMove *m = mp->cur; m < mp->endMoves; m++)
     if (is_capture(pos, m->move))
       m->value =  PieceValue[MG][piece_on(to_sq(m->move))]
                 - type_of_p(moved_piece(m->move));
@@ -121,146 +183,180 @@ static void score_evasions(const Position *pos)
 }
 
 
+// split_captures() evaluates SEE for the whole capture list at once. It
+// drops the ttMove and then either discards captures below the ProbCut
+// threshold or moves losing captures to the front of the list, where they
+// are kept in score order as bad captures.
+
+static void split_captures(const Position *pos, bool probCut)
+{
+  MovePickerState *mp = picker(pos->st);
+  ExtMove *begin = mp->cur, *end = begin;
+  int see[MAX_MOVES];
+
+  see_batch(pos, begin, mp->endMoves, see);
+
+  for (ExtMove *m = begin; m < mp->endMoves; m++)
+    if (   m->move != mp->ttMove
+        && (!probCut || see[m - begin] >= mp->threshold))
+    {
+      see[end - begin] = see[m - begin];
+      *end++ = *m;
+    }
+  mp->endMoves = end;
+
+  if (probCut)
+    return;
+
+  mp->endBadCaptures = begin;
+  for (ExtMove *m = begin; m < end; m++)
+    if (see[m - begin] < -69 * m->value / 1024) {
+      ExtMove tmp = *m;
+      *m = *mp->endBadCaptures;
+      *mp->endBadCaptures++ = tmp;
+    }
+
+  partial_insertion_sort(begin, mp->endBadCaptures, INT_MIN);
+}
+
+
 // next_move() returns the next pseudo-legal move to be searched.
 
 Move next_move(const Position *pos, bool skipQuiets)
 {
-  Stack *st = pos->st;
+  MovePickerState *mp = picker(pos->st);
   Move move;
 
-  switch (st->stage) {
+  switch (mp->stage) {
 
   case ST_MAIN_SEARCH: case ST_EVASION: case ST_QSEARCH: case ST_PROBCUT:
-    st->endMoves = (st-1)->endMoves;
-    st->stage++;
-    return st->ttMove;
+    mp->endMoves = (mp-1)->endMoves;
+    mp->stage++;
+    return mp->ttMove;
 
   case ST_CAPTURES_INIT:
-    st->endBadCaptures = st->cur = (st-1)->endMoves;
-    st->endMoves = generate_captures(pos, st->cur);
+    mp->cur = (mp-1)->endMoves;
+    mp->endMoves = generate_captures(pos, mp->cur);
     score_captures(pos);
-    st->stage++;
+    split_captures(pos, false);
+    mp->cur = mp->endBadCaptures;
+    mp->stage++;
     /* fallthrough */
 
   case ST_GOOD_CAPTURES:
-    while (st->cur < st->endMoves) {
-      move = pick_best(st->cur++, st->endMoves);
-      if (move != st->ttMove) {
-        if (see_test(pos, move, -69 * (st->cur-1)->value / 1024))
-          return move;
-
-        // Losing capture, move it to the beginning of the array.
-        (st->endBadCaptures++)->move = move;
-      }
-    }
-    st->stage++;
+    if (mp->cur < mp->endMoves)
+      return pick_best(mp->cur++, mp->endMoves);
+    mp->stage++;
 
     // First killer move.
-    move = st->mpKillers[0];
-    if (move && move != st->ttMove && is_pseudo_legal(pos, move)
-             && !is_capture(pos, move))
+    move = mp->mpKillers[0];
+    if (move && move != mp->ttMove && is_pseudo_legal(pos, move)
+             && !is_capture(pos, move) && is_legal(pos, move))
       return move;
     /* fallthrough */
 
   case ST_KILLERS:
-    st->stage++;
-    move = st->mpKillers[1]; // Second killer move.
-    if (move && move != st->ttMove && is_pseudo_legal(pos, move)
-             && !is_capture(pos, move))
+    mp->stage++;
+    move = mp->mpKillers[1]; // Second killer move.
+    if (move && move != mp->ttMove && is_pseudo_legal(pos, move)
+             && !is_capture(pos, move) && is_legal(pos, move))
       return move;
     /* fallthrough */
 
   case ST_KILLERS_2:
-    st->stage++;
-    move = st->countermove;
-    if (move && move != st->ttMove && move != st->mpKillers[0]
-             && move != st->mpKillers[1] && is_pseudo_legal(pos, move)
-             && !is_capture(pos, move))
+    mp->stage++;
+    move = mp->countermove;
+    if (move && move != mp->ttMove && move != mp->mpKillers[0]
+             && move != mp->mpKillers[1] && is_pseudo_legal(pos, move)
+             && !is_capture(pos, move) && is_legal(pos, move))
       return move;
     /* fallthrough */
 
   case ST_QUIET_INIT:
     if (!skipQuiets) {
-      st->cur = st->endBadCaptures;
-      st->endMoves = generate_quiets(pos, st->cur);
+      mp->cur = mp->endBadCaptures;
+      mp->endMoves = generate_quiets(pos, mp->cur);
       score_quiets(pos);
-      partial_insertion_sort(st->cur, st->endMoves, -3000 * st->depth);
+      partial_insertion_sort(mp->cur, mp->endMoves, -3000 * mp->depth);
     }
-    st->stage++;
+    mp->stage++;
     /* fallthrough */
 
   case ST_QUIET:
     if (!skipQuiets)
-      while (st->cur < st->endMoves) {
-        move = (st->cur++)->move;
-        if (   move != st->ttMove && move != st->mpKillers[0]
-            && move != st->mpKillers[1] && move != st->countermove)
+      while (mp->cur < mp->endMoves) {
+        move = (mp->cur++)->move;
+        if (   move != mp->ttMove && move != mp->mpKillers[0]
+            && move != mp->mpKillers[1] && move != mp->countermove)
+        {
+          prefetch_next(pos, mp->cur, mp->endMoves);
           return move;
+        }
       }
-    st->stage++;
-    st->cur = (st-1)->endMoves; // Return to bad captures.
+    mp->stage++;
+    mp->cur = (mp-1)->endMoves; // Return to bad captures.
     /* fallthrough */
 
   case ST_BAD_CAPTURES:
-    if (st->cur < st->endBadCaptures)
-      return (st->cur++)->move;
+    if (mp->cur < mp->endBadCaptures) {
+      prefetch_next(pos, mp->cur + 1, mp->endBadCaptures);
+      return (mp->cur++)->move;
+    }
     break;
 
   case ST_EVASIONS_INIT:
-    st->cur = (st-1)->endMoves;
-    st->endMoves = generate_evasions(pos, st->cur);
+    mp->cur = (mp-1)->endMoves;
+    mp->endMoves = generate_evasions(pos, mp->cur);
     score_evasions(pos);
-    st->stage++;
+    mp->stage++;
 
   case ST_ALL_EVASIONS:
-    while (st->cur < st->endMoves) {
-      move = pick_best(st->cur++, st->endMoves);
-      if (move != st->ttMove)
+    while (mp->cur < mp->endMoves) {
+      move = pick_best(mp->cur++, mp->endMoves);
+      if (move != mp->ttMove)
         return move;
     }
     break;
 
   case ST_QCAPTURES_INIT:
-    st->cur = (st-1)->endMoves;
-    st->endMoves = generate_captures(pos, st->cur);
+    mp->cur = (mp-1)->endMoves;
+    mp->endMoves = generate_captures(pos, mp->cur);
     score_captures(pos);
-    st->stage++;
+    mp->stage++;
 
   case ST_QCAPTURES:
-    while (st->cur < st->endMoves) {
-      move = pick_best(st->cur++, st->endMoves);
-      if (move != st->ttMove && (st->depth > DEPTH_QS_RECAPTURES
-              || to_sq(move) == st->recaptureSquare))
+    while (mp->cur < mp->endMoves) {
+      move = pick_best(mp->cur++, mp->endMoves);
+      if (move != mp->ttMove && (mp->depth > DEPTH_QS_RECAPTURES
+              || to_sq(move) == mp->recaptureSquare))
         return move;
     }
-    if (st->depth <= DEPTH_QS_NO_CHECKS)
+    if (mp->depth <= DEPTH_QS_NO_CHECKS)
       break;
-    st->cur = (st-1)->endMoves;
-    st->endMoves = generate_quiet_checks(pos, st->cur);
-    st->stage++;
+    mp->cur = (mp-1)->endMoves;
+    mp->endMoves = generate_quiet_checks(pos, mp->cur);
+    mp->stage++;
     /* fallthrough */
 
   case ST_QCHECKS:
-    while (st->cur < st->endMoves) {
-      move = (st->cur++)->move;
-      if (move != st->ttMove)
+    while (mp->cur < mp->endMoves) {
+      move = (mp->cur++)->move;
+      if (move != mp->ttMove)
         return move;
     }
     break;
 
   case ST_PROBCUT_INIT:
-    st->cur = (st-1)->endMoves;
-    st->endMoves = generate_captures(pos, st->cur);
+    mp->cur = (mp-1)->endMoves;
+    mp->endMoves = generate_captures(pos, mp->cur);
     score_captures(pos);
-    st->stage++;
+    split_captures(pos, true);
+    mp->stage++;
     /* fallthrough */
 
   case ST_PROBCUT_2:
-    while (st->cur < st->endMoves) {
-      move = pick_best(st->cur++, st->endMoves);
-      if (move != st->ttMove && see_test(pos, move, st->threshold))
-        return move;
-    }
+    if (mp->cur < mp->endMoves)
+      return pick_best(mp->cur++, mp->endMoves);
     break;
 
   default:
@@ -270,3 +366,178 @@ Move next_move(const Position *pos, bool skipQuiets)
 
   return 0;
 }
+
+
+// The batched history updates below apply h += v - h * |v| / d to a buffer
+// of entries. The division by the constant d is a multiplication by the
+// magic number m followed by a shift by 32 + s, which is exact for every
+// product below 2^32. The result is clamped to [-lim, lim].
+
+#if defined(USE_AVX2)
+INLINE __m256i gravity_div(__m256i h, __m256i absV, __m256i m, __m128i sh)
+{
+  __m256i a = _mm256_mullo_epi32(_mm256_abs_epi32(h), absV);
+  __m256i even = _mm256_srl_epi64(_mm256_mul_epu32(a, m),
+                                  _mm_add_epi64(sh, _mm_cvtsi32_si128(32)));
+  __m256i odd = _mm256_srl_epi64(_mm256_mul_epu32(_mm256_srli_epi64(a, 32), m), sh);
+  return _mm256_sign_epi32(_mm256_blend_epi32(even, odd, 0xAA), h);
+}
+#elif defined(USE_SSE41)
+INLINE __m128i gravity_div(__m128i h, __m128i absV, __m128i m, __m128i sh)
+{
+  __m128i a = _mm_mullo_epi32(_mm_abs_epi32(h), absV);
+  __m128i even = _mm_srl_epi64(_mm_mul_epu32(a, m),
+                               _mm_add_epi64(sh, _mm_cvtsi32_si128(32)));
+  __m128i odd = _mm_srl_epi64(_mm_mul_epu32(_mm_srli_epi64(a, 32), m), sh);
+  return _mm_sign_epi32(_mm_blend_epi16(even, odd, 0xCC), h);
+}
+#endif
+
+static void gravity_batch(int32_t *h, int n, int v, int lim, int d,
+                          uint32_t m, int s)
+{
+  int i = 0;
+
+#if defined(USE_AVX2)
+  const __m256i vv = _mm256_set1_epi32(v), absV = _mm256_set1_epi32(abs(v));
+  const __m256i vm = _mm256_set1_epi32(m), vlim = _mm256_set1_epi32(lim);
+  const __m256i vnlim = _mm256_set1_epi32(-lim);
+  const __m128i sh = _mm_cvtsi32_si128(s);
+  for (; i + 8 <= n; i += 8) {
+    __m256i x = _mm256_loadu_si256((__m256i *)&h[i]);
+    x = _mm256_sub_epi32(_mm256_add_epi32(x, vv), gravity_div(x, absV, vm, sh));
+    x = _mm256_max_epi32(_mm256_min_epi32(x, vlim), vnlim);
+    _mm256_storeu_si256((__m256i *)&h[i], x);
+  }
+#elif defined(USE_SSE41)
+  const __m128i vv = _mm_set1_epi32(v), absV = _mm_set1_epi32(abs(v));
+  const __m128i vm = _mm_set1_epi32(m), vlim = _mm_set1_epi32(lim);
+  const __m128i vnlim = _mm_set1_epi32(-lim);
+  const __m128i sh = _mm_cvtsi32_si128(s);
+  for (; i + 4 <= n; i += 4) {
+    __m128i x = _mm_loadu_si128((__m128i *)&h[i]);
+    x = _mm_sub_epi32(_mm_add_epi32(x, vv), gravity_div(x, absV, vm, sh));
+    x = _mm_max_epi32(_mm_min_epi32(x, vlim), vnlim);
+    _mm_storeu_si128((__m128i *)&h[i], x);
+  }
+#else
+  (void)m; (void)s;
+#endif
+
+  for (; i < n; i++) {
+    int x = h[i] + v - h[i] * abs(v) / d;
+    h[i] = x > lim ? lim : x < -lim ? -lim : x;
+  }
+}
+
+// history_update_batch() applies history_update() with bonus v to the n
+// moves. The searched quiet moves of a node have distinct from-to squares,
+// so every entry is updated exactly once.
+
+void history_update_batch(ButterflyHistory history, Color c,
+                          const Move *moves, int n, int v)
+{
+  int32_t h[64];
+
+  assert(n <= 64);
+
+  for (int i = 0; i < n; i++)
+    h[i] = history[c][moves[i] & 4095];
+  gravity_batch(h, n, v, INT32_MAX, 13365, 0x273a7a8d, 11);
+  for (int i = 0; i < n; i++)
+    history[c][moves[i] & 4095] = h[i];
+}
+
+// cms_update_batch() applies cms_update() with bonus v to the entries
+// [pcs[i]][tos[i]] of each of the tables. Pieces equal to UINT8_MAX are
+// skipped. Since all updates use the same bonus, their order does not
+// matter: an entry that occurs more than once, because two moves share
+// the piece and the square or because a table is passed twice, is updated
+// once in the batch and the remaining times one by one.
+
+void cms_update_batch(PieceToHistory **tables, int numTables,
+                      const uint8_t *pcs, const uint8_t *tos, int n, int v)
+{
+  PieceToHistory *tab[4];
+  int times[4], numTabs = 0;
+  int uniq[64], dup[64], numUniq = 0, numDup = 0;
+  uint64_t seen[12] = { 0 };
+  int8_t *entry[4 * 64];
+  int32_t h[4 * 64];
+  int num = 0;
+
+  assert(n <= 64 && numTables <= 4);
+
+  for (int t = 0; t < numTables; t++) {
+    int k = 0;
+    while (k < numTabs && tab[k] != tables[t])
+      k++;
+    if (k == numTabs) {
+      tab[numTabs] = tables[t];
+      times[numTabs++] = 0;
+    }
+    times[k]++;
+  }
+
+  for (int i = 0; i < n; i++) {
+    if (pcs[i] == UINT8_MAX)
+      continue;
+    int sq = pcs[i] * 64 + tos[i];
+    if (seen[sq >> 6] & (1ULL << (sq & 63)))
+      dup[numDup++] = i;
+    else {
+      seen[sq >> 6] |= 1ULL << (sq & 63);
+      uniq[numUniq++] = i;
+    }
+  }
+
+  for (int t = 0; t < numTabs; t++)
+    for (int j = 0; j < numUniq; j++) {
+      entry[num] = &(*tab[t])[pcs[uniq[j]]][tos[uniq[j]]];
+      h[num] = *entry[num];
+      num++;
+    }
+  gravity_batch(h, num, v / 120, 127, 250, 0x10624dd3, 4);
+  for (int i = 0; i < num; i++)
+    *entry[i] = h[i];
+
+  for (int t = 0; t < numTabs; t++) {
+    for (int k = 1; k < times[t]; k++)
+      for (int j = 0; j < numUniq; j++)
+        cms_update(*tab[t], pcs[uniq[j]], tos[uniq[j]], v);
+    for (int k = 0; k < times[t]; k++)
+      for (int j = 0; j < numDup; j++)
+        cms_update(*tab[t], pcs[dup[j]], tos[dup[j]], v);
+  }
+}
+
+// mp_bench() is a microbenchmark for the 'mpbench' debug command. It
+// generates the moves of the current position, gives them random values
+// and times picking all of them in order with pick_best().
+
+void mp_bench(const Position *pos, int iterations)
+{
+  ExtMove list[MAX_MOVES], work[MAX_MOVES];
+  ExtMove *end = checkers() ? generate_evasions(pos, list)
+                            : generate_non_evasions(pos, list);
+  int n = end - list;
+  uint64_t sum = 0;
+  PRNG rng;
+
+  prng_init(&rng, 1070372);
+  for (int i = 0; i < n; i++)
+    list[i].value = (int)(prng_rand(&rng) >> 40) - (1 << 23);
+
+  TimePoint start = now();
+  for (int it = 0; it < iterations; it++) {
+    memcpy(work, list, n * sizeof(ExtMove));
+    for (ExtMove *p = work; p < work + n; p++)
+      sum += pick_best(p, work + n);
+  }
+  TimePoint elapsed = now() - start;
+
+  printf("info string mpbench moves %d picks %" PRIu64 " time %" PRId64
+         " checksum %" PRIu64 "\n", n, (uint64_t)n * iterations,
+         (int64_t)elapsed / 1000, sum);
+  fflush(stdout);
+}
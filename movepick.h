@@ -61,6 +61,11 @@ INLINE void cpth_update(CapturePieceToHistory history, Piece pc, Square to,
   history[pc][to][captured] += v - history[pc][to][captured] * abs(v) / 10692;
 }
 
+void history_update_batch(ButterflyHistory history, Color c,
+                          const Move *moves, int n, int v);
+void cms_update_batch(PieceToHistory **tables, int numTables,
+                      const uint8_t *pcs, const uint8_t *tos, int n, int v);
+
 enum {
   ST_MAIN_SEARCH, ST_CAPTURES_INIT, ST_GOOD_CAPTURES, ST_KILLERS, ST_KILLERS_2,
   ST_QUIET_INIT, ST_QUIET, ST_BAD_CAPTURES,
@@ -72,7 +77,10 @@ enum {
   ST_PROBCUT, ST_PROBCUT_INIT, ST_PROBCUT_2
 };
 
+// next_move() only returns legal moves: the generators are legal-only and
+// the ttMove, killers and countermove are tested before being returned.
 Move next_move(const Position *pos, bool skipQuiets);
+void mp_bench(const Position *pos, int iterations);
 
 // Initialisation of move picker data.
 
@@ -81,54 +89,55 @@ INLINE void mp_init(const Position *pos, Move ttm, Depth d, int ply)
   assert(d > 0);
 
   Stack *st = pos->st;
+  MovePickerState *mp = picker(st);
 
-  st->depth = d;
-  st->mp_ply = ply;
+  mp->depth = d;
+  mp->mp_ply = ply;
 
   Square prevSq = to_sq((st-1)->currentMove);
-  st->countermove = counterMoves[piece_on(prevSq)][prevSq];
-  st->mpKillers[0] = st->killers[0];
-  st->mpKillers[1] = st->killers[1];
-
-  st->ttMove = ttm;
-  st->stage = checkers() ? ST_EVASION : ST_MAIN_SEARCH;
-  if (!ttm || !is_pseudo_legal(pos, ttm))
-    st->stage++;
+  mp->countermove = counterMoves[piece_on(prevSq)][prevSq];
+  mp->mpKillers[0] = st->killers[0];
+  mp->mpKillers[1] = st->killers[1];
+
+  mp->ttMove = ttm;
+  mp->stage = checkers() ? ST_EVASION : ST_MAIN_SEARCH;
+  if (!ttm || !is_pseudo_legal(pos, ttm) || !is_legal(pos, ttm))
+    mp->stage++;
 }
 
 INLINE void mp_init_q(const Position *pos, Move ttm, Depth d, Square s)
 {
   assert(d <= 0);
 
-  Stack *st = pos->st;
+  MovePickerState *mp = picker(pos->st);
 
-  st->ttMove = ttm;
-  st->stage = checkers() ? ST_EVASION : ST_QSEARCH;
+  mp->ttMove = ttm;
+  mp->stage = checkers() ? ST_EVASION : ST_QSEARCH;
   if (!(   ttm
         && (checkers() || d > DEPTH_QS_RECAPTURES || to_sq(ttm) == s)
-        && is_pseudo_legal(pos, ttm)))
-    st->stage++;
+        && is_pseudo_legal(pos, ttm) && is_legal(pos, ttm)))
+    mp->stage++;
 
-  st->depth = d;
-  st->recaptureSquare = s;
+  mp->depth = d;
+  mp->recaptureSquare = s;
 }
 
 INLINE void mp_init_pc(const Position *pos, Move ttm, Value th)
 {
   assert(!checkers());
 
-  Stack *st = pos->st;
+  MovePickerState *mp = picker(pos->st);
 
-  st->threshold = th;
+  mp->threshold = th;
 
-  st->ttMove = ttm;
-  st->stage = ST_PROBCUT;
+  mp->ttMove = ttm;
+  mp->stage = ST_PROBCUT;
 
   // In ProbCut we generate captures with SEE higher than the given
   // threshold.
   if (!(ttm && is_pseudo_legal(pos, ttm) && is_capture(pos, ttm)
-            && see_test(pos, ttm, th)))
-    st->stage++;
+            && is_legal(pos, ttm) && see_test(pos, ttm, th)))
+    mp->stage++;
 }
 
 #endif
@@ -9,7 +9,9 @@
 #include <stdio.h>
 
 #include "misc.h"
+#include "position.h"
 #include "settings.h"
+#include "thread.h"
 #include "types.h"
 
 static int numNodes;
@@ -153,6 +155,25 @@ int bind_thread_to_numa_node(int threadIdx)
   return node;
 }
 
+// numa_print_placement() summarises the node of each search thread and the
+// nodes the transposition table is interleaved over.
+
+void numa_print_placement(void)
+{
+  if (!settings.numaEnabled)
+    return;
+
+  printf("info string NUMA threads");
+  for (int idx = 0; idx < Threads.numThreads; idx++)
+    printf(" %d:%d", idx, Threads.pos[idx]->numaNode);
+  printf(" hash interleaved on nodes");
+  for (int node = 0; node < numNodes; node++)
+    if (numa_bitmask_isbitset(settings.mask, node))
+      printf(" %d", node);
+  printf("\n");
+  fflush(stdout);
+}
+
 #else /* NUMA on Windows */
 
 typedef BOOL (WINAPI *GLPIEX)(LOGICAL_PROCESSOR_RELATIONSHIP,
@@ -391,6 +412,18 @@ int bind_thread_to_numa_node(int threadIdx)
   return node;
 }
 
+void numa_print_placement(void)
+{
+  if (!settings.numaEnabled)
+    return;
+
+  printf("info string NUMA threads");
+  for (int idx = 0; idx < Threads.numThreads; idx++)
+    printf(" %d:%d", idx, Threads.pos[idx]->numaNode);
+  printf("\n");
+  fflush(stdout);
+}
+
 void *numa_alloc(size_t size)
 {
   if (impVirtualAllocExNuma) {
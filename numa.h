@@ -15,6 +15,7 @@ void numa_exit(void);
 void read_numa_nodes(char *str);
 struct bitmask *numa_thread_to_node(int idx);
 int bind_thread_to_numa_node(int idx);
+void numa_print_placement(void);
 
 #ifndef _WIN32
 typedef struct bitmask *NodeMask;
@@ -35,6 +36,7 @@ typedef int NodeMask;
 #define numa_interleave_memory(a, b, c) do {} while (0)
 #define numa_free(ptr, size) free(ptr)
 #define bind_thread_to_numa_node(a) 0
+#define numa_print_placement() do {} while (0)
 
 #endif
 
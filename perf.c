@@ -0,0 +1,122 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2008 Tord Romstad (Glaurung author)
+  Copyright (C) 2008-2015 Marco Costalba, Joona Kiiski, Tord Romstad
+  Copyright (C) 2015-2018 Marco Costalba, Joona Kiiski, Gary Linscott, Tord Romstad
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifdef PERF_EVENTS
+
+#include <errno.h>
+#include <inttypes.h>
+#include <linux/perf_event.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "perf.h"
+
+// Hardware performance counters of the calling thread, read through
+// perf_event_open(). Each event is opened on its own so that a kernel or
+// virtual machine that lacks some of them still reports the others.
+
+static const struct {
+  uint32_t type;
+  uint64_t config;
+  const char *name;
+} Events[PERF_NB] = {
+  { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK,       "task-clock"    },
+  { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES,       "cycles"        },
+  { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS,     "instructions"  },
+  { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES,     "cache-misses"  },
+  { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES,    "branch-misses" }
+};
+
+static int fds[PERF_NB] = { -1, -1, -1, -1, -1 };
+static bool reported;
+
+// perf_open() starts counting for the calling thread. Events that cannot
+// be opened, e.g. because perf_event_paranoid denies access, are reported
+// once and then left out.
+
+void perf_open(void)
+{
+  for (int i = 0; i < PERF_NB; i++) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = Events[i].type;
+    attr.config = Events[i].config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    fds[i] = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+    if (fds[i] < 0 && !reported)
+      printf("info string perf %s unavailable: %s\n", Events[i].name,
+             strerror(errno));
+  }
+  reported = true;
+  fflush(stdout);
+}
+
+void perf_close(void)
+{
+  for (int i = 0; i < PERF_NB; i++)
+    if (fds[i] >= 0) {
+      close(fds[i]);
+      fds[i] = -1;
+    }
+}
+
+void perf_read(PerfCounts *pc)
+{
+  for (int i = 0; i < PERF_NB; i++)
+    if (fds[i] < 0 || read(fds[i], &pc->v[i], sizeof(uint64_t)) != sizeof(uint64_t))
+      pc->v[i] = 0;
+}
+
+// perf_print() prints the counter deltas between two readings, together
+// with instructions per cycle and the miss rates per thousand instructions.
+
+void perf_print(const char *label, const PerfCounts *begin,
+    const PerfCounts *end)
+{
+  uint64_t d[PERF_NB];
+  for (int i = 0; i < PERF_NB; i++)
+    d[i] = end->v[i] - begin->v[i];
+
+  printf("info string perf %s", label);
+  for (int i = 0; i < PERF_NB; i++)
+    if (fds[i] >= 0)
+      printf(" %s %" PRIu64, Events[i].name, d[i]);
+  if (fds[PERF_CYCLES] >= 0 && fds[PERF_INSTRUCTIONS] >= 0 && d[PERF_CYCLES])
+    printf(" ipc %.2f", (double)d[PERF_INSTRUCTIONS] / d[PERF_CYCLES]);
+  if (fds[PERF_INSTRUCTIONS] >= 0 && d[PERF_INSTRUCTIONS]) {
+    if (fds[PERF_CACHE_MISSES] >= 0)
+      printf(" cache-mpki %.2f", 1000.0 * d[PERF_CACHE_MISSES] / d[PERF_INSTRUCTIONS]);
+    if (fds[PERF_BRANCH_MISSES] >= 0)
+      printf(" branch-mpki %.2f", 1000.0 * d[PERF_BRANCH_MISSES] / d[PERF_INSTRUCTIONS]);
+  }
+  printf("\n");
+  fflush(stdout);
+}
+
+#else
+
+typedef int make_iso_compilers_happy;
+
+#endif
@@ -0,0 +1,45 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2008 Tord Romstad (Glaurung author)
+  Copyright (C) 2008-2015 Marco Costalba, Joona Kiiski, Tord Romstad
+  Copyright (C) 2015-2018 Marco Costalba, Joona Kiiski, Gary Linscott, Tord Romstad
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PERF_H
+#define PERF_H
+
+#include "types.h"
+
+#ifdef PERF_EVENTS
+
+enum {
+  PERF_TASK_CLOCK, PERF_CYCLES, PERF_INSTRUCTIONS, PERF_CACHE_MISSES,
+  PERF_BRANCH_MISSES, PERF_NB
+};
+
+typedef struct {
+  uint64_t v[PERF_NB];
+} PerfCounts;
+
+void perf_open(void);
+void perf_close(void);
+void perf_read(PerfCounts *pc);
+void perf_print(const char *label, const PerfCounts *begin,
+    const PerfCounts *end);
+
+#endif
+
+#endif
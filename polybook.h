@@ -0,0 +1,23 @@
+#ifndef POLYBOOK_H
+#define POLYBOOK_H
+
+#include "misc.h"
+#include "types.h"
+
+struct PolyBook {
+  const uint8_t *data;
+  map_t map;
+  size_t count;
+};
+
+typedef struct PolyBook PolyBook;
+
+extern PolyBook polybook, polybook2;
+
+void pb_init(PolyBook *pb, const char *file);
+void pb_free(void);
+void pb_set_best_book_move(bool best);
+void pb_set_book_depth(int depth);
+Move pb_probe(const Position *pos);
+
+#endif
@@ -80,20 +80,20 @@ INLINE void move_piece(Position *pos, Color c, Piece piece, Square from,
 
 INLINE void set_check_info(Position *pos)
 {
-  Stack *st = pos->st;
+  CheckInfo *ci = check_info(pos->st);
 
-  st->blockersForKing[WHITE] = slider_blockers(pos, pieces_c(BLACK), square_of(WHITE, KING), &st->pinnersForKing[WHITE]);
-  st->blockersForKing[BLACK] = slider_blockers(pos, pieces_c(WHITE), square_of(BLACK, KING), &st->pinnersForKing[BLACK]);
+  ci->blockersForKing[WHITE] = slider_blockers(pos, pieces_c(BLACK), square_of(WHITE, KING), &ci->pinnersForKing[WHITE]);
+  ci->blockersForKing[BLACK] = slider_blockers(pos, pieces_c(WHITE), square_of(BLACK, KING), &ci->pinnersForKing[BLACK]);
 
   Color them = !stm();
-  st->ksq = square_of(them, KING);
-
-  st->checkSquares[PAWN]   = attacks_from_pawn(st->ksq, them);
-  st->checkSquares[KNIGHT] = attacks_from_knight(st->ksq);
-  st->checkSquares[BISHOP] = attacks_from_bishop(st->ksq);
-  st->checkSquares[ROOK]   = attacks_from_rook(st->ksq);
-  st->checkSquares[QUEEN]  = st->checkSquares[BISHOP] | st->checkSquares[ROOK];
-  st->checkSquares[KING]   = 0;
+  ci->ksq = square_of(them, KING);
+
+  ci->checkSquares[PAWN]   = attacks_from_pawn(ci->ksq, them);
+  ci->checkSquares[KNIGHT] = attacks_from_knight(ci->ksq);
+  ci->checkSquares[BISHOP] = attacks_from_bishop(ci->ksq);
+  ci->checkSquares[ROOK]   = attacks_from_rook(ci->ksq);
+  ci->checkSquares[QUEEN]  = ci->checkSquares[BISHOP] | ci->checkSquares[ROOK];
+  ci->checkSquares[KING]   = 0;
 }
 
 INLINE Key H1(Key h)
@@ -161,6 +161,38 @@ void zob_init(void) {
 }
 
 
+// stacks_size() returns the number of bytes to allocate for a Stack array
+// of 'slots' entries and its parallel arrays, including the slack needed by
+// pos_init_stacks() to align each array to a cache line.
+
+size_t stacks_size(int slots)
+{
+  size_t size = sizeof(Stack) + sizeof(CheckInfo) + sizeof(MovePickerState);
+#ifdef NNUE
+  size += sizeof(NNUEState);
+#endif
+  return 4 * 63 + slots * size;
+}
+
+// pos_init_stacks() lays out the Stack array and its parallel arrays of
+// 'slots' entries in pos->stackAllocation.
+
+void pos_init_stacks(Position *pos, int slots)
+{
+  uintptr_t p = ((uintptr_t)pos->stackAllocation + 0x3f) & ~0x3f;
+
+  pos->stack = (Stack *)p;
+  p = (p + slots * sizeof(Stack) + 0x3f) & ~0x3f;
+  pos->ciStack = (CheckInfo *)p;
+  p = (p + slots * sizeof(CheckInfo) + 0x3f) & ~0x3f;
+  pos->mpStack = (MovePickerState *)p;
+#ifdef NNUE
+  p = (p + slots * sizeof(MovePickerState) + 0x3f) & ~0x3f;
+  pos->nnueStack = (NNUEState *)p;
+#endif
+}
+
+
 // pos_set() initializes the position object with the given FEN string.
 // This function is not very robust - make sure that input FENs are correct,
 // this is assumed to be the responsibility of the GUI.
@@ -639,35 +671,36 @@ bool gives_check_special(const Position *pos, Stack *st, Move m)
   assert(move_is_ok(m));
   assert(color_of(moved_piece(m)) == stm());
 
+  const CheckInfo *ci = check_info(st);
   Square from = from_sq(m);
   Square to = to_sq(m);
 
-  if ((blockers_for_king(pos, !stm()) & sq_bb(from)) && !aligned(m, st->ksq))
+  if ((blockers_for_king(pos, !stm()) & sq_bb(from)) && !aligned(m, ci->ksq))
     return true;
 
   switch (type_of_m(m)) {
   case NORMAL:
-    return st->checkSquares[type_of_p(piece_on(from))] & sq_bb(to);
+    return ci->checkSquares[type_of_p(piece_on(from))] & sq_bb(to);
 
   case PROMOTION:
-    return attacks_bb(promotion_type(m), to, pieces() ^ sq_bb(from)) & sq_bb(st->ksq);
+    return attacks_bb(promotion_type(m), to, pieces() ^ sq_bb(from)) & sq_bb(ci->ksq);
 
   case ENPASSANT:
   {
-    if (st->checkSquares[PAWN] & sq_bb(to))
+    if (ci->checkSquares[PAWN] & sq_bb(to))
       return true;
     Square capsq = make_square(file_of(to), rank_of(from));
 //    Bitboard b = pieces() ^ sq_bb(from) ^ sq_bb(capsq) ^ sq_bb(to);
     Bitboard b = inv_sq(inv_sq(inv_sq(pieces(), from), to), capsq);
-    return  (attacks_bb_rook  (st->ksq, b) & pieces_cpp(stm(), QUEEN, ROOK))
-          ||(attacks_bb_bishop(st->ksq, b) & pieces_cpp(stm(), QUEEN, BISHOP));
+    return  (attacks_bb_rook  (ci->ksq, b) & pieces_cpp(stm(), QUEEN, ROOK))
+          ||(attacks_bb_bishop(ci->ksq, b) & pieces_cpp(stm(), QUEEN, BISHOP));
   }
   case CASTLING:
   {
     // Castling is encoded as 'King captures the rook'
     Square rto = relative_square(stm(), to > from ? SQ_F1 : SQ_D1);
-    return   (PseudoAttacks[ROOK][rto] & sq_bb(st->ksq))
-          && (attacks_bb_rook(rto, pieces() ^ sq_bb(from)) & sq_bb(st->ksq));
+    return   (PseudoAttacks[ROOK][rto] & sq_bb(ci->ksq))
+          && (attacks_bb_rook(rto, pieces() ^ sq_bb(from)) & sq_bb(ci->ksq));
   }
   default:
     assume(false);
@@ -696,9 +729,10 @@ void do_move(Position *pos, Move m, int givesCheck)
   st->plyCounters += 0x101; // Increment both rule50 and pliesFromNull
 
 #ifdef NNUE
-  st->accumulator.state[WHITE] = ACC_EMPTY;
-  st->accumulator.state[BLACK] = ACC_EMPTY;
-  DirtyPiece *dp = &(st->dirtyPiece);
+  NNUEState *ns = nnue_state(st);
+  ns->accumulator.state[WHITE] = ACC_EMPTY;
+  ns->accumulator.state[BLACK] = ACC_EMPTY;
+  DirtyPiece *dp = &(ns->dirtyPiece);
   dp->dirtyNum = 1;
 #endif
 
@@ -912,6 +946,17 @@ void do_move(Position *pos, Move m, int givesCheck)
   // Update the key with the final value
   st->key = key;
 
+  // Prefetch the correction history entries that changed with this move,
+  // they are read when the new position is evaluated.
+  if (st->pawnKey != (st-1)->pawnKey)
+    prefetch(pawn_corr(st->pawnKey));
+  if (st->minorPieceKey != (st-1)->minorPieceKey)
+    prefetch(minor_corr(st->minorPieceKey));
+  if (st->nonPawnKey[us] != (st-1)->nonPawnKey[us])
+    prefetch(non_pawn_corr(us, st->nonPawnKey[us]));
+  if (st->nonPawnKey[them] != (st-1)->nonPawnKey[them])
+    prefetch(non_pawn_corr(them, st->nonPawnKey[them]));
+
   // Calculate checkers bitboard (if move gives check)
 #if 1
   st->checkersBB =  givesCheck
@@ -919,10 +964,10 @@ void do_move(Position *pos, Move m, int givesCheck)
 #else
   st->checkersBB = 0;
   if (givesCheck) {
-    if (type_of_m(m) != NORMAL || ((st-1)->blockersForKing[them] & sq_bb(from)))
+    if (type_of_m(m) != NORMAL || (check_info(st-1)->blockersForKing[them] & sq_bb(from)))
       st->checkersBB = attackers_to(square_of(them, KING)) & pieces_c(us);
     else
-      st->checkersBB = (st-1)->checkSquares[piece & 7] & sq_bb(to);
+      st->checkersBB = check_info(st-1)->checkSquares[piece & 7] & sq_bb(to);
   }
 #endif
 
@@ -1016,10 +1061,11 @@ void do_null_move(Position *pos)
   Stack *st = ++pos->st;
   memcpy(st, st - 1, (StateSize + 7) & ~7);
 #ifdef NNUE
-  st->accumulator.state[WHITE] = ACC_EMPTY;
-  st->accumulator.state[BLACK] = ACC_EMPTY;
-  st->dirtyPiece.dirtyNum = 0;
-  st->dirtyPiece.pc[0] = 0;
+  NNUEState *ns = nnue_state(st);
+  ns->accumulator.state[WHITE] = ACC_EMPTY;
+  ns->accumulator.state[BLACK] = ACC_EMPTY;
+  ns->dirtyPiece.dirtyNum = 0;
+  ns->dirtyPiece.pc[0] = 0;
 #endif
 
   if (unlikely(st->epSquare)) {
@@ -1089,7 +1135,7 @@ bool see_test(const Position *pos, Move m, int value)
     attackers &= occ;
     if (!(stmAttackers = attackers & pieces_c(stm))) break;
     if (    (stmAttackers & blockers_for_king(pos, stm))
-        && (pos->st->pinnersForKing[stm] & occ))
+        && (check_info(pos->st)->pinnersForKing[stm] & occ))
       stmAttackers &= ~blockers_for_king(pos, stm);
     if (!stmAttackers) break;
     res = !res;
@@ -1127,6 +1173,88 @@ bool see_test(const Position *pos, Move m, int value)
 }
 
 
+// see_swap() resolves the exchange sequence on 'to' started by the piece
+// on 'from' and returns its value. 'attackers' are all attackers to 'to'
+// in the current position. Pins and king captures follow see_test().
+
+static int see_swap(const Position *pos, Square from, Square to,
+    Bitboard attackers)
+{
+  int gain[32], d = 0;
+  Bitboard occ = pieces() ^ sq_bb(from) ^ sq_bb(to), stmAttackers, bb;
+  Color stm = color_of(piece_on(from));
+  int victim = PieceValue[MG][piece_on(from)];
+  PieceType pt;
+
+  gain[0] = PieceValue[MG][piece_on(to)];
+
+  // Moving the first capturer away may uncover a slider behind it.
+  if (PseudoAttacks[BISHOP][to] & sq_bb(from))
+    attackers |= attacks_bb_bishop(to, occ) & pieces_pp(BISHOP, QUEEN);
+  else if (PseudoAttacks[ROOK][to] & sq_bb(from))
+    attackers |= attacks_bb_rook(to, occ) & pieces_pp(ROOK, QUEEN);
+
+  while (true) {
+    stm = !stm;
+    attackers &= occ;
+    stmAttackers = attackers & pieces_c(stm);
+    if (    (stmAttackers & blockers_for_king(pos, stm))
+        && (check_info(pos->st)->pinnersForKing[stm] & occ))
+      stmAttackers &= ~blockers_for_king(pos, stm);
+    if (!stmAttackers) break;
+
+    for (pt = PAWN; !(bb = stmAttackers & pieces_p(pt)); pt++);
+
+    // The king may only capture if the square is no longer defended.
+    if (pt == KING && (attackers & ~pieces_c(stm)))
+      break;
+
+    d++;
+    gain[d] = victim - gain[d - 1];
+    victim = PieceValue[MG][pt];
+    occ ^= bb & -bb;
+    if (pt == PAWN || pt == BISHOP || pt == QUEEN)
+      attackers |= attacks_bb_bishop(to, occ) & pieces_pp(BISHOP, QUEEN);
+    if (pt == ROOK || pt == QUEEN)
+      attackers |= attacks_bb_rook(to, occ) & pieces_pp(ROOK, QUEEN);
+  }
+
+  // Each side may stop capturing if continuing would lose material.
+  for (; d > 0; d--)
+    gain[d - 1] = min(gain[d - 1], -gain[d]);
+
+  return gain[0];
+}
+
+
+// see_batch() computes the SEE value of every move in (begin, end) such
+// that see_test(pos, m, v) == (value >= v). Attackers to a target square
+// are computed once and shared by all captures on that square.
+
+void see_batch(const Position *pos, const ExtMove *begin, const ExtMove *end,
+    int *values)
+{
+  Bitboard attackersTo[64], known = 0;
+
+  for (const ExtMove *p = begin; p < end; p++, values++) {
+    Move m = p->move;
+    if (unlikely(type_of_m(m) != NORMAL)) {
+      *values = 0;
+      continue;
+    }
+
+    Square to = to_sq(m);
+    if (!(known & sq_bb(to))) {
+      known |= sq_bb(to);
+      attackersTo[to] = attackers_to(to);
+    }
+    *values = see_swap(pos, from_sq(m), to, attackersTo[to]);
+
+    assert(see_test(pos, m, *values) && !see_test(pos, m, *values + 1));
+  }
+}
+
+
 // is_draw() tests whether the position is drawn by 50-move rule or by
 // repetition. It does not detect stalemates.
 
@@ -1138,7 +1266,8 @@ bool is_draw(const Position *pos)
   if (unlikely(st->rule50 > 99)) {
     if (!checkers())
       return true;
-    return generate_legal(pos, (st-1)->endMoves) != (st-1)->endMoves;
+    ExtMove *list = picker(st-1)->endMoves;
+    return generate_legal(pos, list) != list;
   }
 
   // st->pliesFromNull is reset both on null moves and on zeroing moves.
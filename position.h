@@ -52,7 +52,9 @@ void psqt_init(void);
 void zob_init(void);
 
 // Stack struct stores information needed to restore a Position struct to
-// its previous state when we retract a move.
+// its previous state when we retract a move, followed by the search stack
+// data of the ply. It is exactly two cache lines and the board state that
+// do_move() copies and is_draw() scans is in the first one.
 
 struct Stack {
   // Copied when making a move
@@ -97,19 +99,24 @@ struct Stack {
   bool ttPv;
   bool ttHit;
   uint8_t ply;
+};
 
-  // MovePicker data
-  uint8_t stage;
-  uint8_t recaptureSquare;
-  uint8_t mp_ply;
-  Move countermove;
-  Depth depth;
-  Move ttMove;
-  Value threshold;
-  Move mpKillers[2];
-  ExtMove *cur, *endMoves, *endBadCaptures;
+typedef struct Stack Stack;
+
+// check_info(), picker() and nnue_state() index the parallel arrays by
+// (st) - pos->stack, which only compiles to a shift while the size of a
+// Stack is a power of two. Without pawnKey and psq, or with 32-bit
+// pointers, the size is different anyway.
+#if defined(IS_64BIT) && !defined(NNUE_PURE)
+_Static_assert(sizeof(Stack) == 128, "Stack must stay 128 bytes");
+#endif
 
-  // CheckInfo data
+// The data of a ply that do_move() and undo_move() do not need is kept in
+// arrays parallel to the Stack array, indexed by the same slot: the check
+// info, which gives_check() and the move generators read, the move picker
+// state and the NNUE accumulators.
+
+typedef struct {
   Bitboard blockersForKing[2];
   union {
     struct {
@@ -121,20 +128,55 @@ struct Stack {
     };
   };
   Square ksq;
+} CheckInfo;
+
+// A search that reuses the same slot, such as the singular extension search
+// excluding the ttMove, overwrites the move picker data. Saving and
+// restoring a copy lets the picker resume exactly where it left off.
+
+typedef struct {
+  uint8_t stage;
+  uint8_t recaptureSquare;
+  uint8_t mp_ply;
+  Move countermove;
+  Depth depth;
+  Move ttMove;
+  Value threshold;
+  Move mpKillers[2];
+  ExtMove *cur, *endMoves, *endBadCaptures;
+} MovePickerState;
 
 #ifdef NNUE
-  // NNUE data
+typedef struct {
   Accumulator accumulator;
   DirtyPiece dirtyPiece;
+} NNUEState;
 #endif
-};
 
-typedef struct Stack Stack;
+// The search keeps the moves of a node that did not become the best move
+// for the history updates after the move loop, in one entry per ply.
+
+typedef struct {
+  Move captures[32];
+  Move quiets[64];
+} SearchedMoves;
+
+// The PV of ply p is stored in row p of a per-thread triangular table. Row
+// p has room for the moves of plies p to MAX_PLY and a terminating 0.
+enum {
+  PV_ROWS = MAX_PLY + 2,
+  PV_TABLE_SIZE = PV_ROWS * (PV_ROWS + 1) / 2
+};
 
 #define StateCopySize offsetof(Stack, capturedPiece)
 #define StateSize offsetof(Stack, pv)
 #define SStackBegin(st) (&st.pv)
-#define SStackSize (offsetof(Stack, countermove) - offsetof(Stack, pv))
+#define SStackSize (sizeof(Stack) - offsetof(Stack, pv))
+
+// The parallel data of Stack entry 'st' of the position 'pos'
+#define check_info(st) (&pos->ciStack[(st) - pos->stack])
+#define picker(st) (&pos->mpStack[(st) - pos->stack])
+#define nnue_state(st) (&pos->nnueStack[(st) - pos->stack])
 
 
 // Position struct stores information regarding the board representation as
@@ -163,8 +205,17 @@ struct Position {
   // Relevant mainly to the search of the root position.
   RootMoves *rootMoves;
   Stack *stack;
+  CheckInfo *ciStack;
+  MovePickerState *mpStack;
+#ifdef NNUE
+  NNUEState *nnueStack;
+#endif
+  Move *pvTable;
+  SearchedMoves *searched;
   uint64_t nodes;
+  uint64_t tbHits;
   uint64_t ttHitAverage;
+  SearchStats stats;
   int pvIdx, pvLast;
   int selDepth, nmpMinPly;
   Color nmpColor;
@@ -178,12 +229,15 @@ struct Position {
   uint64_t bestMoveChanges;
   atomic_bool resetCalls;
   int callsCnt;
-  int action;
+  atomic_int action;
   int threadIdx;
+  int numaNode;
 #ifndef _WIN32
   pthread_t nativeThread;
   pthread_mutex_t mutex;
   pthread_cond_t sleepCondition;
+  atomic_bool parked;  // Thread blocked waiting for an action
+  atomic_int waiting;  // Threads blocked waiting for this one to sleep
 #else
   HANDLE nativeThread;
   HANDLE startEvent, stopEvent;
@@ -193,6 +247,8 @@ struct Position {
 
 // FEN string input/output
 void pos_set(Position *pos, char *fen, int isChess960);
+size_t stacks_size(int slots);
+void pos_init_stacks(Position *pos, int slots);
 
 //PURE Bitboard attackers_to_occ(const Position *pos, Square s, Bitboard occupied);
 PURE Bitboard slider_blockers(const Position *pos, Bitboard sliders, Square s,
@@ -210,6 +266,8 @@ INLINE void undo_null_move(Position *pos);
 
 // Static exchange evaluation
 PURE bool see_test(const Position *pos, Move m, int value);
+void see_batch(const Position *pos, const ExtMove *begin, const ExtMove *end,
+    int *values);
 
 PURE Key key_after(const Position *pos, Move m);
 PURE bool is_draw(const Position *pos);
@@ -277,7 +335,7 @@ PURE bool has_game_cycle(const Position *pos, int ply);
 
 INLINE Bitboard blockers_for_king(const Position *pos, Color c)
 {
-  return pos->st->blockersForKing[c];
+  return check_info(pos->st)->blockersForKing[c];
 }
 
 INLINE bool pawn_passed(const Position *pos, Color c, Square s)
@@ -309,7 +367,7 @@ INLINE bool is_capture(const Position *pos, Move m)
 INLINE bool gives_check(const Position *pos, Stack *st, Move m)
 {
   return  type_of_m(m) == NORMAL && !(blockers_for_king(pos, !stm()) & pieces_c(stm()))
-        ? (bool)(st->checkSquares[type_of_p(moved_piece(m))] & sq_bb(to_sq(m)))
+        ? (bool)(check_info(st)->checkSquares[type_of_p(moved_piece(m))] & sq_bb(to_sq(m)))
         : gives_check_special(pos, st, m);
 }
 
@@ -26,9 +26,11 @@
 #include "misc.h"
 #include "movegen.h"
 #include "movepick.h"
-// #include "polybook.h"
+#include "perf.h"
+#include "polybook.h"
 #include "search.h"
 #include "settings.h"
+#include "tbprobe.h"
 #include "timeman.h"
 #include "thread.h"
 #include "tt.h"
@@ -41,9 +43,115 @@ LimitsType Limits;
 
 static int base_ct;
 
+#ifdef PERF_EVENTS
+// Counter readings of the main thread at the start of the search and after
+// the last completed iteration
+static PerfCounts perfStart, perfIter;
+#endif
+
+// Search statistics of the last search, summed over all threads
+static SearchStats lastStats;
+static uint64_t lastTtHitAverage;
+static uint64_t lastNodes;
+static uint64_t lastTbHits;
+static struct { Move move; uint64_t effort; } lastEffort[3];
+
 // Different node types, used as template parameter
 enum { NonPV, PV };
 
+#ifdef PROFILE
+
+// Search profiler, enabled with 'make profile=yes'. Every search_node()
+// and qsearch_node() call opens a frame whose label is switched by
+// PROF_STEP() as the node proceeds. The cycles between two profiler events
+// are charged to the label active at the top of the frame stack, so time
+// spent in child nodes is not counted twice.
+
+#include <x86intrin.h>
+
+enum {
+  PROF_OTHER, // Labels 1 to 20 are the steps of search_node()
+  PROF_QS_INIT = 21, PROF_QS_EVAL, PROF_QS_MOVES, PROF_QS_MAKE, PROF_QS_END,
+  PROF_NB
+};
+
+static const char *ProfNames[PROF_NB] = {
+  "other", "Step 1", "Step 2", "Step 3", "Step 4", "Step 5", "Step 6",
+  "Step 7", "Step 8", "Step 9", "Step 10", "Step 11", "Step 12", "Step 13",
+  "Step 14", "Step 15", "Step 16", "Step 17", "Step 18", "Step 19",
+  "Step 20", "qsearch init", "qsearch eval", "qsearch moves",
+  "qsearch make", "qsearch end"
+};
+
+static struct {
+  uint64_t cycles[PROF_NB], calls[PROF_NB];
+  uint64_t last;
+  int sp;
+  uint8_t label[4 * MAX_PLY];
+} prof;
+
+INLINE void prof_charge(void)
+{
+  uint64_t t = __rdtsc();
+  prof.cycles[prof.label[prof.sp]] += t - prof.last;
+  prof.last = t;
+}
+
+INLINE void prof_step(int l)
+{
+  prof_charge();
+  prof.label[prof.sp] = l;
+  prof.calls[l]++;
+}
+
+INLINE void prof_enter(int l)
+{
+  prof_charge();
+  assert(prof.sp < 4 * MAX_PLY - 1);
+  prof.label[++prof.sp] = l;
+}
+
+INLINE void prof_leave(void)
+{
+  prof_charge();
+  prof.sp--;
+}
+
+static void prof_reset(void)
+{
+  memset(&prof, 0, sizeof(prof));
+  prof.last = __rdtsc();
+}
+
+static void prof_print(void)
+{
+  uint64_t total = 0;
+
+  prof_charge();
+  for (int l = 0; l < PROF_NB; l++)
+    total += prof.cycles[l];
+
+  for (int l = 0; l < PROF_NB; l++)
+    if (prof.cycles[l])
+      printf("info string profile %-13s calls %12" PRIu64 " cycles %14"
+             PRIu64 " per call %6" PRIu64 " share %5.2f%%\n", ProfNames[l],
+             prof.calls[l], prof.cycles[l],
+             prof.calls[l] ? prof.cycles[l] / prof.calls[l] : 0,
+             100.0 * prof.cycles[l] / (total ? total : 1));
+}
+
+#define PROF_STEP(l)  prof_step(l)
+#define PROF_ENTER(l) prof_enter(l)
+#define PROF_LEAVE()  prof_leave()
+
+#else
+
+#define PROF_STEP(l)  ((void)0)
+#define PROF_ENTER(l) ((void)0)
+#define PROF_LEAVE()  ((void)0)
+
+#endif
+
 static const uint64_t ttHitAverageWindow     = 4096;
 static const uint64_t ttHitAverageResolution = 1024;
 
@@ -68,10 +176,10 @@ INLINE int futility_move_count(bool improving, Depth depth)
 
 int correction_value(Position *pos, Stack *ss) {
   Color us = stm();
-  Value pcv = pawnCorrectionHistory[ss->pawnKey & (PAWN_CORRECTION_HISTORY_SIZE - 1)][us];
-  Value micv = minorPieceCorrectionHistory[ss->minorPieceKey & (MINOR_CORRECTION_HISTORY_SIZE - 1)][us];
-  Value wnpcv = nonPawnCorrectionHistory[WHITE][ss->nonPawnKey[WHITE] & (NON_PAWN_CORRECTION_HISTORY_SIZE - 1)][us];
-  Value bnpcv = nonPawnCorrectionHistory[BLACK][ss->nonPawnKey[BLACK] & (NON_PAWN_CORRECTION_HISTORY_SIZE - 1)][us];
+  Value pcv = pawn_corr(ss->pawnKey)[us];
+  Value micv = minor_corr(ss->minorPieceKey)[us];
+  Value wnpcv = non_pawn_corr(WHITE, ss->nonPawnKey[WHITE])[us];
+  Value bnpcv = non_pawn_corr(BLACK, ss->nonPawnKey[BLACK])[us];
 
   return 7000 * pcv + 6300 * micv + 7550 * (wnpcv + bnpcv);
 }
@@ -127,13 +235,25 @@ static Value value_to_tt(Value v, int ply);
 static Value value_from_tt(Value v, int ply, int r50c);
 static void update_pv(Move *pv, Move move, Move *childPv);
 static void update_cm_stats(Stack *ss, Piece pc, Square s, int bonus);
+static void update_cm_stats_batch(const Position *pos, Stack *ss,
+    const Move *moves, int n, int bonus);
 static void update_quiet_stats(const Position *pos, Stack *ss, Move move,
     int bonus);
 static void update_capture_stats(const Position *pos, Move move, Move *captures,
     int captureCnt, int bonus);
 static void check_time(void);
+static int calls_cnt(void);
 static void stable_sort(RootMove *rm, int num);
 static int extract_ponder_from_tt(RootMove *rm, Position *pos);
+static bool reuse_pv(Position *pos);
+static void save_pv(Position *pos, RootMove *rm, Depth depth);
+
+// pv_row() returns row 'ply' of the triangular PV table of the thread.
+
+INLINE Move *pv_row(const Position *pos, int ply)
+{
+  return pos->pvTable + ply * PV_ROWS - ply * (ply - 1) / 2;
+}
 
 // search_init() is called during startup to initialize various lookup tables
 
@@ -155,10 +275,14 @@ void search_clear(void)
 
   Time.availableNodes = 0;
 
-  tt_clear();
+  // A deferred clear follows the allocation of the table, which has left
+  // it cleared or resumed from its file
+  if (!delayedSettings.clear)
+    tt_clear();
 
   mainThread.previousScore = VALUE_INFINITE;
   mainThread.previousTimeReduction = 1;
+  mainThread.reuseKey = 0;
 }
 
 
@@ -172,8 +296,8 @@ INLINE uint64_t perft_node(Position *pos, Depth depth, const bool Root)
   uint64_t cnt, nodes = 0;
   const bool leaf = (depth == 2);
 
-  ExtMove *m = Root ? pos->moveList : (pos->st-1)->endMoves;
-  ExtMove *last = pos->st->endMoves = generate_legal(pos, m);
+  ExtMove *m = Root ? pos->moveList : picker(pos->st-1)->endMoves;
+  ExtMove *last = picker(pos->st)->endMoves = generate_legal(pos, m);
   for (; m < last; m++) {
     if (Root && depth <= 1) {
       cnt = 1;
@@ -211,10 +335,11 @@ void mainthread_search(void)
 {
   Position *pos = Threads.pos[0];
   Color us = stm();
+  TimePoint searchStart = now();
   time_init(us, game_ply());
   tt_new_search();
   char buf[16];
-  // bool playBookMove = false;
+  bool playBookMove = false;
 
 #ifdef NNUE
   switch (useNNUE) {
@@ -239,14 +364,50 @@ void mainthread_search(void)
              : strcmp(s, "black") == 0 && us == WHITE ? -base_ct
              : base_ct;
 
-  if (pos->rootMoves->size > 0) {
+  // Play a book move without waking the search threads
+  if (pos->rootMoves->size > 0 && !Limits.infinite && !Limits.mate) {
+    Move bookMove = pb_probe(pos);
+    for (int i = 0; bookMove && i < pos->rootMoves->size; i++)
+      if (pos->rootMoves->move[i].pv[0] == bookMove) {
+        RootMove tmp = pos->rootMoves->move[0];
+        pos->rootMoves->move[0] = pos->rootMoves->move[i];
+        pos->rootMoves->move[i] = tmp;
+        playBookMove = true;
+        break;
+      }
+  }
+
+  if (playBookMove)
+    pos->completedDepth = 0;
+
+  else if (pos->rootMoves->size > 0 && reuse_pv(pos))
+    pos->completedDepth = mainThread.reuseDepth;
+
+  else if (pos->rootMoves->size > 0) {
     Threads.pos[0]->bestMoveChanges = 0;
     for (int idx = 1; idx < Threads.numThreads; idx++) {
       Threads.pos[idx]->bestMoveChanges = 0;
       thread_wake_up(Threads.pos[idx], THREAD_SEARCH);
     }
 
+#ifdef PROFILE
+    prof_reset();
+#endif
+#ifdef PERF_EVENTS
+    perf_open();
+    perf_read(&perfStart);
+    perfIter = perfStart;
+#endif
     thread_search(pos); // Let's start searching!
+#ifdef PROFILE
+    prof_print();
+#endif
+#ifdef PERF_EVENTS
+    PerfCounts perfEnd;
+    perf_read(&perfEnd);
+    perf_print("search", &perfStart, &perfEnd);
+    perf_close();
+#endif
   }
 
   // When we reach the maximum depth, we can arrive here without Threads.stop
@@ -264,6 +425,7 @@ void mainthread_search(void)
     UNLOCK(Threads.lock);
 
   // Stop the other threads if they have not stopped already
+  time_mark_stop(now());
   Threads.stop = true;
 
   // Wait until all threads have finished
@@ -276,6 +438,32 @@ void mainthread_search(void)
     pos->rootMoves->size++;
   }
 
+  // Sum up the search statistics of all threads for the 'stats' command
+  memset(&lastStats, 0, sizeof(lastStats));
+  for (int idx = 0; idx < Threads.numThreads; idx++) {
+    const uint64_t *src = (const uint64_t *)&Threads.pos[idx]->stats;
+    uint64_t *dst = (uint64_t *)&lastStats;
+    for (size_t i = 0; i < sizeof(SearchStats) / sizeof(uint64_t); i++)
+      dst[i] += src[i];
+  }
+  lastTtHitAverage = pos->ttHitAverage;
+  lastTbHits = threads_tb_hits();
+
+  // Keep the root moves the main thread spent most nodes on
+  lastNodes = pos->nodes;
+  memset(lastEffort, 0, sizeof(lastEffort));
+  for (int i = 0; i < pos->rootMoves->size; i++) {
+    const RootMove *rm = &pos->rootMoves->move[i];
+    int j = 3;
+    for (; j > 0 && lastEffort[j - 1].effort < rm->effort; j--)
+      if (j < 3)
+        lastEffort[j] = lastEffort[j - 1];
+    if (j < 3) {
+      lastEffort[j].move = rm->pv[0];
+      lastEffort[j].effort = rm->effort;
+    }
+  }
+
   // When playing in 'nodes as time' mode, subtract the searched nodes from
   // the available ones before exiting.
   if (Limits.npmsec)
@@ -285,6 +473,7 @@ void mainthread_search(void)
   Position *bestThread = pos;
   if (    option_value(OPT_MULTI_PV) == 1
       && !Limits.depth
+      && !playBookMove
 //      && !Skill(option_value(OPT_SKILL_LEVEL)).enabled()
       &&  pos->rootMoves->move[0].pv[0] != 0)
   {
@@ -336,6 +525,14 @@ void mainthread_search(void)
   printf("\n");
   fflush(stdout);
   funlockfile(stdout);
+
+  save_pv(pos, &bestThread->rootMoves->move[0], bestThread->completedDepth);
+
+  // Only time-managed searches sample the latencies that the automatic move
+  // overhead is derived from
+  if (use_time_management() && !playBookMove)
+    time_record_latency(searchStart - Limits.startTime,
+                        now() - atomic_load(&Time.stopTime));
 }
 
 
@@ -347,7 +544,6 @@ void mainthread_search(void)
 void thread_search(Position *pos)
 {
   Value bestValue, alpha, beta, delta;
-  Move pv[MAX_PLY + 1];
   Move lastBestMove = 0;
   Depth lastBestMoveDepth = 0;
   double timeReduction = 1.0, totBestMoveChanges = 0;
@@ -357,18 +553,18 @@ void thread_search(Position *pos)
   for (int i = -7; i < 3; i++) {
     memset(SStackBegin(ss[i]), 0, SStackSize);
 #ifdef NNUE
-    ss[i].accumulator.state[WHITE] = ACC_INIT;
-    ss[i].accumulator.state[BLACK] = ACC_INIT;
+    nnue_state(ss + i)->accumulator.state[WHITE] = ACC_INIT;
+    nnue_state(ss + i)->accumulator.state[BLACK] = ACC_INIT;
 #endif
   }
-  (ss-1)->endMoves = pos->moveList;
+  picker(ss-1)->endMoves = pos->moveList;
 
   for (int i = -7; i < 0; i++)
     ss[i].history = &cmhTable[0][0][0]; // Use as sentinel
 
   for (int i = 0; i <= MAX_PLY; i++)
     ss[i].ply = i;
-  ss->pv = pv;
+  ss->pv = pv_row(pos, 0);
 
   bestValue = delta = alpha = -VALUE_INFINITE;
   beta = VALUE_INFINITE;
@@ -381,6 +577,7 @@ void thread_search(Position *pos)
     else
       for (int i = 0; i < 4; i++)
         mainThread.iterValue[i] = mainThread.previousScore;
+    mainThread.solveIters = 0;
   }
 
   int multiPV = option_value(OPT_MULTI_PV);
@@ -428,8 +625,10 @@ void thread_search(Position *pos)
       pos->pvIdx = pvIdx;
       if (pvIdx == pvLast) {
         pvFirst = pvLast;
-        pvLast = rm->size;
-        pos->pvLast = rm->size;
+        for (pvLast++; pvLast < rm->size; pvLast++)
+          if (rm->move[pvLast].tbRank != rm->move[pvFirst].tbRank)
+            break;
+        pos->pvLast = pvLast;
       }
 
       pos->selDepth = 0;
@@ -505,11 +704,41 @@ void thread_search(Position *pos)
     if (   Limits.mate
         && bestValue >= VALUE_MATE_IN_MAX_PLY
         && VALUE_MATE - bestValue <= 2 * Limits.mate)
+    {
+      time_mark_stop(now());
       Threads.stop = true;
+    }
 
     if (pos->threadIdx != 0)
       continue;
 
+    // When solving a test position, stop once a solution has been the best
+    // move for Limits.solveStable completed iterations.
+    if (Limits.solveStable && !Threads.stop) {
+      if (is_solution(rm->move[0].pv[0])) {
+        if (mainThread.solveIters++ == 0) {
+          mainThread.solveTime = now() - Limits.startTime;
+          mainThread.solveNodes = threads_nodes_searched();
+        }
+        if (mainThread.solveIters >= Limits.solveStable) {
+          time_mark_stop(now());
+          Threads.stop = true;
+        }
+      } else
+        mainThread.solveIters = 0;
+    }
+
+#ifdef PERF_EVENTS
+    if (!Threads.stop) {
+      char label[16];
+      PerfCounts perfNow;
+      perf_read(&perfNow);
+      sprintf(label, "depth %d", pos->completedDepth);
+      perf_print(label, &perfIter, &perfNow);
+      perfIter = perfNow;
+    }
+#endif
+
 #if 0
     // If skill level is enabled and time is up, pick a sub-optimal best move
     if (skill.enabled() && skill.time_to_pick(thread->rootDepth))
@@ -540,22 +769,35 @@ void thread_search(Position *pos)
 
       double totalTime = time_optimum() * fallingEval * reduction * bestMoveInstability;
 
+      // Scale the time by the share of the nodes that went into the best
+      // move. When it absorbs nearly all of the effort it is unlikely to be
+      // overturned, when the effort is spread the choice is still open.
+      double bestMoveEffort = rm->move[0].effort / (double)max(pos->nodes, (uint64_t)1);
+      double effortScale =  pos->completedDepth >= 10 && bestMoveEffort >= 0.9 ? 0.75
+                          : bestMoveEffort < 0.5 ? 1.1 : 1.0;
+      TimePoint elapsed = time_elapsed();
+      pos->stats.effortStop   += elapsed > totalTime * effortScale && elapsed <= totalTime;
+      pos->stats.effortExtend += elapsed <= totalTime * effortScale && elapsed > totalTime;
+      totalTime *= effortScale;
+
       // In the case of a single legal move, cap total time to 500ms.
       if (rm->size == 1)
-        totalTime = min(500.0, totalTime);
+        totalTime = min(500000.0, totalTime);
 
       // Stop the search if we have exceeded the totalTime
-      if (time_elapsed() > totalTime) {
+      if (elapsed > totalTime) {
         // If we are allowed to ponder do not stop the search now but
         // keep pondering until the GUI sends "ponderhit" or "stop".
         if (Threads.ponder)
           Threads.stopOnPonderhit = true;
-        else
+        else {
+          time_mark_stop(now());
           Threads.stop = true;
+        }
       }
       else if (   Threads.increaseDepth
                && !Threads.ponder
-               && time_elapsed() > totalTime * 0.58)
+               && elapsed > totalTime * 0.58)
         Threads.increaseDepth = false;
       else
         Threads.increaseDepth = true;
@@ -614,7 +856,8 @@ INLINE Value search_node(Position *pos, Stack *ss, Value alpha, Value beta,
   assert(0 < depth && depth < MAX_PLY);
   assert(!(PvNode && cutNode));
 
-  Move pv[MAX_PLY+1], capturesSearched[32], quietsSearched[64];
+  Move *capturesSearched = pos->searched[ss->ply].captures;
+  Move *quietsSearched = pos->searched[ss->ply].quiets;
   TTEntry *tte;
   Key posKey;
   Move ttMove, move, excludedMove, bestMove;
@@ -627,6 +870,7 @@ INLINE Value search_node(Position *pos, Stack *ss, Value alpha, Value beta,
   int moveCount, captureCount, quietCount;
 
   // Step 1. Initialize node
+  PROF_STEP(1);
   inCheck = checkers();
   moveCount = captureCount = quietCount =  ss->moveCount = 0;
   bestValue = -VALUE_INFINITE;
@@ -635,7 +879,7 @@ INLINE Value search_node(Position *pos, Stack *ss, Value alpha, Value beta,
   // Check for the available remaining time
   if (load_rlx(pos->resetCalls)) {
     store_rlx(pos->resetCalls, false);
-    pos->callsCnt = 1024;
+    pos->callsCnt = calls_cnt();
   }
   if (--pos->callsCnt <= 0) {
     for (int idx = 0; idx < Threads.numThreads; idx++)
@@ -650,6 +894,7 @@ INLINE Value search_node(Position *pos, Stack *ss, Value alpha, Value beta,
 
   if (!rootNode) {
     // Step 2. Check for aborted search and immediate draw
+    PROF_STEP(2);
     if (load_rlx(Threads.stop) || is_draw(pos) || ss->ply >= MAX_PLY)
       return  ss->ply >= MAX_PLY && !inCheck ? evaluate(pos)
                                              : value_draw(pos);
@@ -661,6 +906,7 @@ INLINE Value search_node(Position *pos, Stack *ss, Value alpha, Value beta,
     // alpha. Same logic but with reversed signs applies also in the
     // opposite condition of being mated instead of giving mate. In this
     // case return a fail-high score.
+    PROF_STEP(3);
     if (PvNode) {
       alpha = max(mated_in(ss->ply), alpha);
       beta = min(mate_in(ss->ply+1), beta);
@@ -696,6 +942,7 @@ INLINE Value search_node(Position *pos, Stack *ss, Value alpha, Value beta,
   // Step 4. Transposition table lookup. We don't want the score of a
   // partial search to overwrite a previous full search TT value, so we
   // use a different position key in case of an excluded move.
+  PROF_STEP(4);
   excludedMove = ss->excludedMove;
   posKey = !excludedMove ? key() : key() ^ make_key(excludedMove);
   tte = tt_probe(posKey, &ss->ttHit);
@@ -737,10 +984,58 @@ INLINE Value search_node(Position *pos, Stack *ss, Value alpha, Value beta,
       return ttValue;
   }
 
+  // Step 5. Tablebase probe
+  PROF_STEP(5);
+  if (!rootNode && TB_Cardinality) {
+    int piecesCnt = popcount(pieces());
+
+    if (    piecesCnt <= TB_Cardinality
+        && (piecesCnt <  TB_Cardinality || depth >= TB_ProbeDepth)
+        &&  rule50_count() == 0
+        && !can_castle_any())
+    {
+      int found, wdl = TB_probe_wdl(pos, &found);
+
+      // Force check of time on the next occasion
+      if (pos->threadIdx == 0)
+        pos->callsCnt = 0;
+
+      if (found) {
+        pos->tbHits++;
+        int drawScore = TB_UseRule50 ? 1 : 0;
+
+        // Use the range VALUE_MATE_IN_MAX_PLY to VALUE_TB_WIN_IN_MAX_PLY
+        value =  wdl < -drawScore ? VALUE_MATED_IN_MAX_PLY + ss->ply + 1
+               : wdl >  drawScore ? VALUE_MATE_IN_MAX_PLY - ss->ply - 1
+               :  VALUE_DRAW + 2 * wdl * drawScore;
+
+        int b =  wdl < -drawScore ? BOUND_UPPER
+               : wdl >  drawScore ? BOUND_LOWER : BOUND_EXACT;
+
+        if (    b == BOUND_EXACT
+            || (b == BOUND_LOWER ? value >= beta : value <= alpha))
+        {
+          tte_save(tte, posKey, value_to_tt(value, ss->ply), ss->ttPv, b,
+                   min(MAX_PLY - 1, depth + 6), 0, VALUE_NONE);
+          return value;
+        }
+
+        if (PvNode) {
+          if (b == BOUND_LOWER) {
+            bestValue = value;
+            alpha = max(alpha, bestValue);
+          } else
+            maxValue = value;
+        }
+      }
+    }
+  }
+
   Value unadjustedStaticEval = VALUE_NONE;
   Value corr_value = correction_value(pos, ss);
 
   // Step 6. Static evaluation of the position
+  PROF_STEP(6);
   if (inCheck) {
     // Skip early pruning when in check
     ss->staticEval = eval = VALUE_NONE;
@@ -789,14 +1084,19 @@ INLINE Value search_node(Position *pos, Stack *ss, Value alpha, Value beta,
              :  ss->staticEval > (ss-2)->staticEval;
 
   // Step 7. Futility pruning: child node
+  PROF_STEP(7);
   if (   !ss->ttPv
       &&  depth < 9
       &&  eval - futility_margin(depth, improving) - (ss-1)->statScore / 256 >= beta
       &&  eval >= beta
       &&  eval < 15000 ) // 50% larger than VALUE_KNOWN_WIN, but smaller than TB wins.
+  {
+    pos->stats.futility++;
     return eval; // - futility_margin(depth); (do not do the right thing)
+  }
 
   // Step 8. Null move search with verification search (is omitted in PV nodes)
+  PROF_STEP(8);
   if (   !PvNode
       && (ss-1)->currentMove != MOVE_NULL
       && (ss-1)->statScore < 23767
@@ -816,11 +1116,14 @@ INLINE Value search_node(Position *pos, Stack *ss, Value alpha, Value beta,
     ss->history = &cmhTable[0][0][0];
 
     do_null_move(pos);
-    ss->endMoves = (ss-1)->endMoves;
+    picker(ss)->endMoves = picker(ss-1)->endMoves;
     Value nullValue = -search_NonPV(pos, ss+1, -beta, depth-R, !cutNode);
     undo_null_move(pos);
+    pos->stats.nullTried++;
 
     if (nullValue >= beta) {
+      pos->stats.nullCut++;
+
       // Do not return unproven mate or TB scores
       if (nullValue >= VALUE_TB_WIN_IN_MAX_PLY)
         nullValue = beta;
@@ -838,6 +1141,8 @@ INLINE Value search_node(Position *pos, Stack *ss, Value alpha, Value beta,
       Value v = search_NonPV(pos, ss, beta-1, depth-R, false);
 
       pos->nmpMinPly = 0;
+      pos->stats.nullVerified++;
+      pos->stats.nullVerifyFail += v < beta;
 
       if (v >= beta)
         return nullValue;
@@ -849,6 +1154,7 @@ INLINE Value search_node(Position *pos, Stack *ss, Value alpha, Value beta,
   // Step 9. ProbCut
   // If we have a good enough capture and a reduced search returns a value
   // much above beta, we can (almost) safely prune the previous move.
+  PROF_STEP(9);
   if (   !PvNode
       &&  depth > 4
       &&  abs(beta) < VALUE_TB_WIN_IN_MAX_PLY
@@ -864,7 +1170,7 @@ INLINE Value search_node(Position *pos, Stack *ss, Value alpha, Value beta,
 
     while (  (move = next_move(pos, 0))
            && probCutCount)
-      if (move != excludedMove && is_legal(pos, move)) {
+      if (move != excludedMove) {
         assert(is_capture_or_promotion(pos, move));
         assert(depth >= 5);
 
@@ -882,11 +1188,15 @@ INLINE Value search_node(Position *pos, Stack *ss, Value alpha, Value beta,
                : -qsearch_NonPV_false(pos, ss+1, -probCutBeta, 0);
 
         // If the qsearch held, perform the regular search
-        if (value >= probCutBeta)
+        pos->stats.probCutTried++;
+        if (value >= probCutBeta) {
+          pos->stats.probCutQsHeld++;
           value = -search_NonPV(pos, ss+1, -probCutBeta, depth - 4, !cutNode);
+        }
 
         undo_move(pos, move);
         if (value >= probCutBeta) {
+          pos->stats.probCutCut++;
           if (!(   ss->ttHit
                 && tte_depth(tte) >= depth - 3
                 && ttValue != VALUE_NONE))
@@ -899,6 +1209,7 @@ INLINE Value search_node(Position *pos, Stack *ss, Value alpha, Value beta,
   }
 
   // Step 10. If the position is not in TT, decrease depth by 2
+  PROF_STEP(10);
   if ( PvNode 
     && depth >= 6 
     && !ttMove)
@@ -915,6 +1226,7 @@ moves_loop: // When in check search starts from here
   int rangeReduction = 0;
 
   // Step 11. A small Probcut idea, when we are in check
+  PROF_STEP(11);
   probCutBeta = beta + 409;
   if (   inCheck
       && !PvNode
@@ -949,7 +1261,7 @@ moves_loop: // When in check search starts from here
   // Step 12. Loop through moves
   // Loop through all pseudo-legal moves until no moves remain or a beta
   // cutoff occurs
-  while ((move = next_move(pos, moveCountPruning))) {
+  while ((PROF_STEP(12), move = next_move(pos, moveCountPruning))) {
     assert(move_is_ok(move));
 
     if (move == excludedMove)
@@ -968,9 +1280,7 @@ moves_loop: // When in check search starts from here
         continue;
     }
 
-    // Check for legality just before making the move
-    if (!rootNode && !is_legal(pos, move))
-      continue;
+    assert(is_legal(pos, move));
 
     ss->moveCount = ++moveCount;
 
@@ -987,6 +1297,7 @@ moves_loop: // When in check search starts from here
     newDepth = depth - 1;
 
     // Step 13. Pruning at shallow depth
+    PROF_STEP(13);
     if (  !rootNode
         && non_pawn_material_c(stm())
         && bestValue > VALUE_TB_LOSS_IN_MAX_PLY)
@@ -1039,6 +1350,7 @@ moves_loop: // When in check search starts from here
     }
 
     // Step 14. Extensions
+    PROF_STEP(14);
 
     // Singular extension search. If all moves but one fail low on a search
     // of (alpha-s, beta-s), and just one fails high on (alpha, beta), then
@@ -1056,13 +1368,18 @@ moves_loop: // When in check search starts from here
     {
       Value singularBeta = ttValue - 3 * depth;
       Depth singularDepth = (depth - 1) / 2;
+      // The ttMove is always picked before any moves are generated, so
+      // the move list above picker(ss-1)->endMoves is still free for the
+      // verification search. Only the picker fields of ss need saving.
+      MovePickerState mps = *picker(ss);
+      assert(mps.stage == ST_CAPTURES_INIT || mps.stage == ST_EVASIONS_INIT);
       ss->excludedMove = move;
-      Move cm = ss->countermove;
-      Move k1 = ss->mpKillers[0], k2 = ss->mpKillers[1];
       value = search_NonPV(pos, ss, singularBeta - 1, singularDepth, cutNode);
       ss->excludedMove = 0;
+      pos->stats.singularTried++;
 
       if (value < singularBeta) {
+        pos->stats.singularExt++;
         extension = 1;
         singularQuietLMR = !ttCapture;
         if ( !PvNode 
@@ -1084,18 +1401,13 @@ moves_loop: // When in check search starts from here
           if (!ttCapture)
             update_quiet_stats(pos, ss, ttMove, -stat_bonus(depth));
 
+          pos->stats.multiCut++;
           return singularBeta;
         }
 
       // If the eval of ttMove is greater than beta we also check whether
       // there is another move that pushes it over beta. If so, we prune.
       else if (ttValue >= beta) {
-        // Fix up our move picker data
-        mp_init(pos, ttMove, depth, ss->ply);
-        ss->stage++;
-        ss->countermove = cm; // pedantic
-        ss->mpKillers[0] = k1; ss->mpKillers[1] = k2;
-
         ss->excludedMove = move;
         value = search_NonPV(pos, ss, beta - 1, (depth + 3) / 2, cutNode);
         ss->excludedMove = 0;
@@ -1105,11 +1417,8 @@ moves_loop: // When in check search starts from here
       }
 
       // The call to search_NonPV with the same value of ss messed up our
-      // move picker data. So we fix it.
-      mp_init(pos, ttMove, depth, ss->ply);
-      ss->stage++;
-      ss->countermove = cm; // pedantic
-      ss->mpKillers[0] = k1; ss->mpKillers[1] = k2;
+      // move picker data. So we restore it.
+      *picker(ss) = mps;
 
     }
     
@@ -1135,6 +1444,8 @@ moves_loop: // When in check search starts from here
     ss->history = &cmhTable[inCheck || captureOrPromotion][piece_to_index[movedPiece]][to_sq(move)];
 
     // Step 15. Make the move.
+    PROF_STEP(15);
+    uint64_t nodeCount = rootNode ? pos->nodes : 0;
     do_move(pos, move, givesCheck);
     // HACK: Fix bench after introduction of 2-fold MultiPV bug
     if (rootNode) pos->st[-1].key ^= pos->rootKeyFlip;
@@ -1146,6 +1457,7 @@ moves_loop: // When in check search starts from here
     // child has been searched. In general we would like to reduce them, but
     // there are many cases where we extend a child if it has good chances
     // to be "interesting".
+    PROF_STEP(16);
     if (    depth >= 3
         &&  moveCount > 1 + 2 * rootNode
         && (   !captureOrPromotion
@@ -1212,12 +1524,16 @@ moves_loop: // When in check search starts from here
       doFullDepthSearch = value > alpha && d < newDepth;
       doDeeperSearch = value > (alpha + 62 + 20 * (newDepth - d));
       didLMR = true;
+      pos->stats.lmrTried++;
+      pos->stats.lmrReSearch += doFullDepthSearch;
+      pos->stats.lmrDeeper += doFullDepthSearch && doDeeperSearch;
     } else {
       doFullDepthSearch = !PvNode || moveCount > 1;
       didLMR = false;
     }
 
     // Step 17. Full depth search when LMR is skipped or fails high.
+    PROF_STEP(17);
     if (doFullDepthSearch) {
       value = -search_NonPV(pos, ss+1, -(alpha+1), newDepth + doDeeperSearch, !cutNode);
 
@@ -1225,6 +1541,9 @@ moves_loop: // When in check search starts from here
         int bonus = value > alpha ?  stat_bonus(newDepth)
                                   : -stat_bonus(newDepth);
 
+        // The reduced search failed high but the full depth one did not
+        pos->stats.lmrReSearchFail += value <= alpha;
+
         if (captureOrPromotion)
           bonus /= 4;
 
@@ -1238,14 +1557,16 @@ moves_loop: // When in check search starts from here
     if (   PvNode
         && (moveCount == 1 || (value > alpha && (rootNode || value < beta))))
     {
-      (ss+1)->pv = pv;
+      (ss+1)->pv = pv_row(pos, ss->ply + 1);
       (ss+1)->pv[0] = 0;
 
+      pos->stats.pvReSearch += moveCount > 1;
       value = -search_PV(pos, ss+1, -beta, -alpha, min(maxNextDepth, newDepth));
     }
 
     // Step 18. Undo move
     // HACK: Fix bench after introduction of 2-fold MultiPV bug
+    PROF_STEP(18);
     if (rootNode) pos->st[-1].key ^= pos->rootKeyFlip;
     undo_move(pos, move);
 
@@ -1254,18 +1575,23 @@ moves_loop: // When in check search starts from here
     // Step 19. Check for a new best move
     // Finished searching the move. If a stop occurred, the return value of
     // the search cannot be trusted, and we return immediately without
-    // updating best move, PV and TT.
-    if (load_rlx(Threads.stop))
-      return 0;
-
+    // updating best move, PV and TT. The nodes spent on a root move are
+    // counted in any case.
+    PROF_STEP(19);
+    RootMove *rm = NULL;
     if (rootNode) {
-      RootMove *rm = NULL;
       for (int idx = 0; idx < pos->rootMoves->size; idx++)
         if (pos->rootMoves->move[idx].pv[0] == move) {
           rm = &pos->rootMoves->move[idx];
           break;
         }
+      rm->effort += pos->nodes - nodeCount;
+    }
+
+    if (load_rlx(Threads.stop))
+      return 0;
 
+    if (rootNode) {
       rm->averageScore = rm->averageScore != -VALUE_INFINITE ? (2 * value + rm->averageScore) / 3 : value;
 
       // PV move or new best move ?
@@ -1330,6 +1656,7 @@ moves_loop: // When in check search starts from here
   // All legal moves have been searched and if there are no legal moves,
   // it must be a mate or a stalemate. If we are in a singular extension
   // search then return a fail low score.
+  PROF_STEP(20);
   if (!moveCount)
     bestValue = excludedMove ? alpha
                :     inCheck ? mated_in(ss->ply) : VALUE_DRAW;
@@ -1342,11 +1669,9 @@ moves_loop: // When in check search starts from here
       update_quiet_stats(pos, ss, bestMove, bonus);
 
       // Decrease all the other played quiet moves
-      for (int i = 0; i < quietCount; i++) {
-        history_update(mainHistory, stm(), quietsSearched[i], -bonus);
-        update_cm_stats(ss, moved_piece(quietsSearched[i]),
-            to_sq(quietsSearched[i]), -bonus);
-      }
+      history_update_batch(mainHistory, stm(), quietsSearched, quietCount,
+          -bonus);
+      update_cm_stats_batch(pos, ss, quietsSearched, quietCount, -bonus);
     }
 
     update_capture_stats(pos, bestMove, capturesSearched, captureCount,
@@ -1391,10 +1716,10 @@ moves_loop: // When in check search starts from here
       {
         Color us = stm();
         int bonus = clamp((int)(bestValue - ss->staticEval) * depth / 8, -CORRECTION_HISTORY_LIMIT / 4, CORRECTION_HISTORY_LIMIT / 4);
-        clamp_correction_histories(&pawnCorrectionHistory[ss->pawnKey & (PAWN_CORRECTION_HISTORY_SIZE - 1)][us], bonus * 114 / 128);
-        clamp_correction_histories(&minorPieceCorrectionHistory[ss->minorPieceKey & (MINOR_CORRECTION_HISTORY_SIZE - 1)][us], bonus * 146 / 128);
-        clamp_correction_histories(&nonPawnCorrectionHistory[WHITE][ss->nonPawnKey[WHITE] & (NON_PAWN_CORRECTION_HISTORY_SIZE - 1)][us], bonus * 165 / 128);
-        clamp_correction_histories(&nonPawnCorrectionHistory[BLACK][ss->nonPawnKey[BLACK] & (NON_PAWN_CORRECTION_HISTORY_SIZE - 1)][us], bonus * 165 / 128);
+        clamp_correction_histories(&pawn_corr(ss->pawnKey)[us], bonus * 114 / 128);
+        clamp_correction_histories(&minor_corr(ss->minorPieceKey)[us], bonus * 146 / 128);
+        clamp_correction_histories(&non_pawn_corr(WHITE, ss->nonPawnKey[WHITE])[us], bonus * 165 / 128);
+        clamp_correction_histories(&non_pawn_corr(BLACK, ss->nonPawnKey[BLACK])[us], bonus * 165 / 128);
       }
 
   assert(bestValue > -VALUE_INFINITE && bestValue < VALUE_INFINITE);
@@ -1406,14 +1731,20 @@ moves_loop: // When in check search starts from here
 static NOINLINE Value search_PV(Position *pos, Stack *ss, Value alpha,
     Value beta, Depth depth)
 {
-  return search_node(pos, ss, alpha, beta, depth, 0, PV);
+  PROF_ENTER(1);
+  Value v = search_node(pos, ss, alpha, beta, depth, 0, PV);
+  PROF_LEAVE();
+  return v;
 }
 
 // search_NonPV is the main search function for non-PV nodes
 static NOINLINE Value search_NonPV(Position *pos, Stack *ss, Value alpha,
     Depth depth, bool cutNode)
 {
-  return search_node(pos, ss, alpha, alpha+1, depth, cutNode, NonPV);
+  PROF_ENTER(1);
+  Value v = search_node(pos, ss, alpha, alpha+1, depth, cutNode, NonPV);
+  PROF_LEAVE();
+  return v;
 }
 
 // qsearch_node() is the quiescence search function template, which is
@@ -1429,7 +1760,6 @@ INLINE Value qsearch_node(Position *pos, Stack *ss, Value alpha, Value beta,
   assert(PvNode || (alpha == beta - 1));
   assert(depth <= 0);
 
-  Move pv[MAX_PLY+1];
   TTEntry *tte;
   Key posKey;
   Move ttMove, move, bestMove;
@@ -1440,7 +1770,7 @@ INLINE Value qsearch_node(Position *pos, Stack *ss, Value alpha, Value beta,
 
   if (PvNode) {
     oldAlpha = alpha; // To flag BOUND_EXACT when eval above alpha and no available moves
-    (ss+1)->pv = pv;
+    (ss+1)->pv = pv_row(pos, ss->ply + 1);
     ss->pv[0] = 0;
   }
 
@@ -1448,6 +1778,7 @@ INLINE Value qsearch_node(Position *pos, Stack *ss, Value alpha, Value beta,
   moveCount = 0;
 
   // Check for an instant draw or if the maximum ply has been reached
+  PROF_STEP(PROF_QS_INIT);
   if (is_draw(pos) || ss->ply >= MAX_PLY)
     return ss->ply >= MAX_PLY && !InCheck ? evaluate(pos) : VALUE_DRAW;
 
@@ -1478,6 +1809,7 @@ INLINE Value qsearch_node(Position *pos, Stack *ss, Value alpha, Value beta,
   Value corr_value = correction_value(pos, ss);
 
   // Evaluate the position statically
+  PROF_STEP(PROF_QS_EVAL);
   if (InCheck) {
     ss->staticEval = VALUE_NONE;
     bestValue = futilityBase = -VALUE_INFINITE;
@@ -1532,14 +1864,9 @@ INLINE Value qsearch_node(Position *pos, Stack *ss, Value alpha, Value beta,
 
   int quietCheckEvasions = 0;
   // Loop through the moves until no moves remain or a beta cutoff occurs
-  while ((move = next_move(pos, 0))) {
+  while ((PROF_STEP(PROF_QS_MOVES), move = next_move(pos, 0))) {
     assert(move_is_ok(move));
-
-
-    // Check for legality 
-    if (!is_legal(pos, move)) {
-      continue;
-    }
+    assert(is_legal(pos, move));
 
     givesCheck = gives_check(pos, ss, move);
 
@@ -1596,6 +1923,7 @@ INLINE Value qsearch_node(Position *pos, Stack *ss, Value alpha, Value beta,
     quietCheckEvasions += !captureOrPromotion && InCheck;
 
     // Make and search the move
+    PROF_STEP(PROF_QS_MAKE);
     do_move(pos, move, givesCheck);
     value = PvNode ? givesCheck
                      ? -qsearch_PV_true(pos, ss+1, -beta, -alpha, depth - 1)
@@ -1627,6 +1955,7 @@ INLINE Value qsearch_node(Position *pos, Stack *ss, Value alpha, Value beta,
 
   // All legal moves have been searched. A special case: If we're in check
   // and no legal moves were found, it is checkmate.
+  PROF_STEP(PROF_QS_END);
   if (InCheck && bestValue == -VALUE_INFINITE)
     return mated_in(ss->ply); // Plies to mate from the root
 
@@ -1643,25 +1972,37 @@ INLINE Value qsearch_node(Position *pos, Stack *ss, Value alpha, Value beta,
 static NOINLINE Value qsearch_PV_true(Position *pos, Stack *ss, Value alpha,
     Value beta, Depth depth)
 {
-  return qsearch_node(pos, ss, alpha, beta, depth, PV, true);
+  PROF_ENTER(PROF_QS_INIT);
+  Value v = qsearch_node(pos, ss, alpha, beta, depth, PV, true);
+  PROF_LEAVE();
+  return v;
 }
 
 static NOINLINE Value qsearch_PV_false(Position *pos, Stack *ss, Value alpha,
     Value beta, Depth depth)
 {
-  return qsearch_node(pos, ss, alpha, beta, depth, PV, false);
+  PROF_ENTER(PROF_QS_INIT);
+  Value v = qsearch_node(pos, ss, alpha, beta, depth, PV, false);
+  PROF_LEAVE();
+  return v;
 }
 
 static NOINLINE Value qsearch_NonPV_true(Position *pos, Stack *ss, Value alpha,
     Depth depth)
 {
-  return qsearch_node(pos, ss, alpha, alpha+1, depth, NonPV, true);
+  PROF_ENTER(PROF_QS_INIT);
+  Value v = qsearch_node(pos, ss, alpha, alpha+1, depth, NonPV, true);
+  PROF_LEAVE();
+  return v;
 }
 
 static NOINLINE Value qsearch_NonPV_false(Position *pos, Stack *ss, Value alpha,
     Depth depth)
 {
-  return qsearch_node(pos, ss, alpha, alpha+1, depth, NonPV, false);
+  PROF_ENTER(PROF_QS_INIT);
+  Value v = qsearch_node(pos, ss, alpha, alpha+1, depth, NonPV, false);
+  PROF_LEAVE();
+  return v;
 }
 
 #define rm_lt(m1,m2) ((m1).score != (m2).score ? (m1).score < (m2).score : (m1).previousScore < (m2).previousScore)
@@ -1754,6 +2095,38 @@ static void update_cm_stats(Stack *ss, Piece pc, Square s, int bonus)
     cms_update(*(ss-6)->history, adjusted_pc, s, bonus);
 }
 
+// update_cm_stats_batch() does the same as update_cm_stats() for each of
+// the n moves, updating all entries in one batch.
+
+static void update_cm_stats_batch(const Position *pos, Stack *ss,
+    const Move *moves, int n, int bonus)
+{
+  PieceToHistory *tables[4];
+  uint8_t pcs[64], tos[64];
+  int numTables = 0;
+
+  if (move_is_ok((ss-1)->currentMove))
+    tables[numTables++] = (ss-1)->history;
+
+  if (move_is_ok((ss-2)->currentMove))
+    tables[numTables++] = (ss-2)->history;
+
+  if (!ss->checkersBB) {
+    if (move_is_ok((ss-4)->currentMove))
+      tables[numTables++] = (ss-4)->history;
+
+    if (move_is_ok((ss-6)->currentMove))
+      tables[numTables++] = (ss-6)->history;
+  }
+
+  for (int i = 0; i < n; i++) {
+    pcs[i] = piece_to_index[moved_piece(moves[i])];
+    tos[i] = to_sq(moves[i]);
+  }
+
+  cms_update_batch(tables, numTables, pcs, tos, n, bonus);
+}
+
 // update_capture_stats() updates move sorting heuristics when a new capture
 // best move is found
 
@@ -1842,11 +2215,47 @@ static void check_time(void)
   if (Threads.ponder)
     return;
 
-  if (   (use_time_management() && elapsed > time_maximum() - 10)
-      // || (Limits.movetime && elapsed >= Limits.movetime)
-      // || (Limits.nodes && threads_nodes_searched() >= Limits.nodes)
-    )
-        Threads.stop = 1;
+  // Leave a margin for unwinding the search and sending bestmove, scaled
+  // down for very short maximum times.
+  TimePoint maximum = time_maximum() - min((TimePoint)10000, time_maximum() / 16);
+  TimePoint movetime = 1000 * (TimePoint)Limits.movetime;
+
+  if (use_time_management() && elapsed > maximum)
+    time_mark_stop(Time.startTime + maximum);
+  else if (Limits.movetime && elapsed >= movetime)
+    time_mark_stop(Time.startTime + movetime);
+  else if (Limits.nodes && threads_nodes_searched() >= Limits.nodes)
+    time_mark_stop(Time.startTime + elapsed);
+  else
+    return;
+
+  Threads.stop = 1;
+}
+
+// calls_cnt() returns the number of search() calls until the next
+// check_time(). Under a time limit the interval follows the measured speed
+// so that the clock is read about every 125 us. Under a node limit it halves
+// the remaining distance to the limit, so that the search stops a handful of
+// nodes past it and, not depending on the clock, always at the same node.
+
+static int calls_cnt(void)
+{
+  uint64_t nodes = threads_nodes_searched();
+  int cnt = 1024;
+
+  if (use_time_management() || Limits.movetime) {
+    TimePoint elapsed = time_elapsed();
+    if (elapsed > 0)
+      cnt = clamp(125 * nodes / elapsed, 16, 1024);
+  }
+
+  if (Limits.nodes) {
+    uint64_t half = nodes < Limits.nodes
+                   ? (Limits.nodes - nodes) / (2 * Threads.numThreads) : 0;
+    cnt = (int)clamp(half, 1, (uint64_t)cnt);
+  }
+
+  return cnt;
 }
 
 // extract_ponder_from_tt() is called in case we have no ponder move
@@ -1882,6 +2291,124 @@ static int extract_ponder_from_tt(RootMove *rm, Position *pos)
   return rm->pvSize > 1;
 }
 
+// reuse_pv() is called before the search. If the opponent has played the
+// reply predicted by the previous search, the rest of its best line is put
+// in front of the root moves so that the search starts from it. If the line
+// was searched deep enough and the TT still agrees, the move is played at
+// once and true is returned.
+
+static bool reuse_pv(Position *pos)
+{
+  RootMoves *moves = pos->rootMoves;
+  int reuseDepth = option_value(OPT_PV_REUSE_DEPTH);
+  int i;
+
+  if (!mainThread.reuseKey || mainThread.reuseKey != key())
+    return false;
+
+  for (i = 0; i < moves->size; i++)
+    if (moves->move[i].pv[0] == mainThread.reusePv[0])
+      break;
+
+  if (i == moves->size || Limits.numSearchmoves)
+    return false;
+
+  // Seed the root moves, keeping the order of the others
+  RootMove rm = moves->move[i];
+  memmove(&moves->move[1], &moves->move[0], i * sizeof(RootMove));
+  rm.pvSize = mainThread.reusePvSize;
+  memcpy(rm.pv, mainThread.reusePv, rm.pvSize * sizeof(Move));
+  moves->move[0] = rm;
+
+  if (   !reuseDepth
+      || mainThread.reuseDepth < reuseDepth
+      || !use_time_management()
+      || Threads.ponder
+      || option_value(OPT_MULTI_PV) != 1)
+    return false;
+
+  bool ttHit;
+  TTEntry *tte = tt_probe(key(), &ttHit);
+  if (   !ttHit
+      || tte_move(tte) != rm.pv[0]
+      || tte_depth(tte) < reuseDepth)
+    return false;
+
+  moves->move[0].score = moves->move[0].previousScore = mainThread.previousScore;
+  return true;
+}
+
+// save_pv() keeps the best line of the finished search for reuse_pv(). The
+// key is that of the position after our move and the expected reply.
+
+static void save_pv(Position *pos, RootMove *rm, Depth depth)
+{
+  mainThread.reuseKey = 0;
+
+  if (rm->pvSize < 3 || depth < 3)
+    return;
+
+  do_move(pos, rm->pv[0], gives_check(pos, pos->st, rm->pv[0]));
+  do_move(pos, rm->pv[1], gives_check(pos, pos->st, rm->pv[1]));
+  mainThread.reuseKey = key();
+  undo_move(pos, rm->pv[1]);
+  undo_move(pos, rm->pv[0]);
+
+  mainThread.reuseDepth = depth - 2;
+  mainThread.reusePvSize = rm->pvSize - 2;
+  memcpy(mainThread.reusePv, rm->pv + 2, mainThread.reusePvSize * sizeof(Move));
+}
+
+// print_stats() prints the search statistics of the last search. Each rule
+// is followed by the rate at which it fired or turned out to be wrong.
+
+#define pct(a, b) ((b) ? 100.0 * (a) / (b) : 0.0)
+
+void print_stats(void)
+{
+  const SearchStats *s = &lastStats;
+  char buf[16];
+
+  flockfile(stdout);
+  printf("info string futility prunes %" PRIu64 "\n", s->futility);
+  printf("info string null move tried %" PRIu64 " cut %" PRIu64 " (%.1f%%)"
+         " verified %" PRIu64 " refuted %" PRIu64 " (%.1f%%)\n",
+         s->nullTried, s->nullCut, pct(s->nullCut, s->nullTried),
+         s->nullVerified, s->nullVerifyFail,
+         pct(s->nullVerifyFail, s->nullVerified));
+  printf("info string probcut tried %" PRIu64 " qsearch held %" PRIu64
+         " cut %" PRIu64 " (%.1f%% of held)\n", s->probCutTried,
+         s->probCutQsHeld, s->probCutCut,
+         pct(s->probCutCut, s->probCutQsHeld));
+  printf("info string singular tried %" PRIu64 " extended %" PRIu64
+         " multicut %" PRIu64 "\n", s->singularTried, s->singularExt,
+         s->multiCut);
+  printf("info string lmr reduced %" PRIu64 " re-searched %" PRIu64
+         " (%.1f%%) deeper %" PRIu64 " re-search failed low %" PRIu64
+         " (%.1f%%)\n", s->lmrTried, s->lmrReSearch,
+         pct(s->lmrReSearch, s->lmrTried), s->lmrDeeper,
+         s->lmrReSearchFail, pct(s->lmrReSearchFail, s->lmrReSearch));
+  printf("info string pv re-searches %" PRIu64 "\n", s->pvReSearch);
+  printf("info string effort");
+  for (int i = 0; i < 3 && lastEffort[i].effort; i++)
+    printf(" %s %.1f%%", uci_move(buf, lastEffort[i].move, option_value(OPT_CHESS960)),
+           pct(lastEffort[i].effort, lastNodes));
+  printf(" stopped early %" PRIu64 " extended %" PRIu64 "\n",
+         s->effortStop, s->effortExtend);
+  printf("info string tt hit average %.1f%%\n", 100.0 * lastTtHitAverage
+         / (ttHitAverageWindow * ttHitAverageResolution));
+  printf("info string tbhits %" PRIu64 "\n", lastTbHits);
+  printf("info string latency us start p50 %" PRId64 " p95 %" PRId64
+         " stop p50 %" PRId64 " p95 %" PRId64 " move overhead %" PRId64 "\n",
+         time_latency(false, 50), time_latency(false, 95),
+         time_latency(true, 50), time_latency(true, 95),
+         time_move_overhead());
+  fflush(stdout);
+  funlockfile(stdout);
+}
+
+#undef pct
+
 // start_thinking() wakes up the main thread to start a new search,
 // then returns immediately.
 
@@ -1892,6 +2419,7 @@ void start_thinking(Position *root, bool ponderMode)
 
   Threads.stopOnPonderhit = false;
   Threads.stop = false;
+  atomic_store(&Time.stopTime, 0);
   Threads.increaseDepth = true;
   Threads.ponder = ponderMode;
 
@@ -1916,6 +2444,9 @@ void start_thinking(Position *root, bool ponderMode)
   for (int i = 0; i < moves->size; i++)
     moves->move[i].pv[0] = list[i].move;
 
+  // Rank the root moves by the tablebases, if the root is in them
+  TB_rank_root_moves(root, moves);
+
   for (int idx = 0; idx < Threads.numThreads; idx++) {
     Position *pos = Threads.pos[idx];
     pos->selDepth = 0;
@@ -1930,14 +2461,21 @@ void start_thinking(Position *root, bool ponderMode)
       rm->move[i].previousScore = -VALUE_INFINITE;
       rm->move[i].averageScore = -VALUE_INFINITE;
       rm->move[i].selDepth = 0;
+      rm->move[i].effort = 0;
+      rm->move[i].tbRank = moves->move[i].tbRank;
+      rm->move[i].tbScore = moves->move[i].tbScore;
     }
+    pos->nodes = 0;
+    pos->tbHits = 0;
+    pos->callsCnt = 0;
+    memset(&pos->stats, 0, sizeof(pos->stats));
     memcpy(pos, root, offsetof(Position, moveList));
     // Copy enough of the root State buffer.
     int n = max(7, root->st->pliesFromNull);
     for (int i = 0; i <= n; i++)
       memcpy(&pos->stack[i], &root->st[i - n], StateSize);
     pos->st = pos->stack + n;
-    (pos->st-1)->endMoves = pos->moveList;
+    picker(pos->st-1)->endMoves = pos->moveList;
     pos_set_check_info(pos);
   }
 
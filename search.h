@@ -37,6 +37,9 @@ struct RootMove {
   Value previousScore;
   Value averageScore;
   int selDepth;
+  uint64_t effort; // Nodes spent on this move in the current search
+  int tbRank;
+  Value tbScore;
   Move pv[MAX_PLY];
 };
 
@@ -66,6 +69,10 @@ struct LimitsType {
   TimePoint startTime;
   int numSearchmoves;
   Move searchmoves[MAX_MOVES];
+  int solveStable;
+  int numSolutions;
+  bool avoidSolutions;
+  Move solutions[8];
 };
 
 typedef struct LimitsType LimitsType;
@@ -77,10 +84,22 @@ INLINE int use_time_management(void)
   return Limits.time[WHITE] || Limits.time[BLACK];
 }
 
+// is_solution() returns whether m solves a test position, i.e. whether it
+// is one of its 'bm' moves or none of its 'am' moves.
+
+INLINE bool is_solution(Move m)
+{
+  for (int i = 0; i < Limits.numSolutions; i++)
+    if (Limits.solutions[i] == m)
+      return !Limits.avoidSolutions;
+  return Limits.avoidSolutions;
+}
+
 void search_init(void);
 void search_clear(void);
 uint64_t perft(Position *pos, Depth depth);
 void start_thinking(Position *pos, bool ponderMode);
+void print_stats(void);
 
 INLINE void clamp_correction_histories(int16_t *entry, int bonus) {
     int clampedBonus = clamp(bonus, -CORRECTION_HISTORY_LIMIT, CORRECTION_HISTORY_LIMIT);
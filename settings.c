@@ -1,3 +1,5 @@
+#include <string.h>
+
 #ifdef NNUE
 #include "nnue.h"
 #endif
@@ -10,11 +12,12 @@
 
 struct settings settings, delayedSettings;
 
-// Process Hash, Threads, NUMA and LargePages settings.
+// Process Hash, Hash File, Threads, NUMA and LargePages settings.
 
 void process_delayed_settings(void)
 {
-  bool ttChange = delayedSettings.ttSize != settings.ttSize;
+  bool ttChange =   delayedSettings.ttSize != settings.ttSize
+                  || strcmp(delayedSettings.ttFile, settings.ttFile) != 0;
   bool lpChange = delayedSettings.largePages != settings.largePages;
   bool numaChange =   settings.numaEnabled != delayedSettings.numaEnabled
                    || (   settings.numaEnabled
@@ -41,11 +44,15 @@ void process_delayed_settings(void)
     tt_free();
     settings.largePages = delayedSettings.largePages;
     settings.ttSize = delayedSettings.ttSize;
+    strcpy(settings.ttFile, delayedSettings.ttFile);
     tt_allocate(settings.ttSize);
   }
 
+  if (numaChange)
+    numa_print_placement();
+
   if (delayedSettings.clear) {
-    delayedSettings.clear = false;
     search_clear();
+    delayedSettings.clear = false;
   }
 }
@@ -6,6 +6,7 @@
 struct settings {
   NodeMask mask;
   size_t ttSize;
+  char ttFile[256];
   size_t numThreads;
   bool numaEnabled;
   bool largePages;
@@ -0,0 +1,1859 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2008 Tord Romstad (Glaurung author)
+  Copyright (C) 2008-2015 Marco Costalba, Joona Kiiski, Tord Romstad
+  Copyright (C) 2015-2018 Marco Costalba, Joona Kiiski, Gary Linscott, Tord Romstad
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <ctype.h>
+#include <inttypes.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bitboard.h"
+#include "misc.h"
+#include "movegen.h"
+#include "position.h"
+#include "search.h"
+#include "tbprobe.h"
+#include "thread.h"
+#include "uci.h"
+
+#define TBPIECES 7
+
+int TB_MaxCardinality;
+int TB_Cardinality;
+bool TB_RootInTB, TB_UseRule50;
+Depth TB_ProbeDepth;
+
+enum { WDL, DTZ };
+
+// Flags of the PairsData of a table
+enum {
+  TB_STM = 1, TB_MAPPED = 2, TB_WIN_PLIES = 4, TB_LOSS_PLIES = 8,
+  TB_WIDE = 16, TB_SINGLE_VALUE = 128
+};
+
+// Outcome of a probe. CHANGE_STM means that the DTZ table only stores the
+// other side to move, ZEROING_BEST_MOVE that the best move zeroes the
+// 50-move counter, so that the stored DTZ value cannot be used.
+enum {
+  PS_FAIL = 0, PS_OK = 1, PS_CHANGE_STM = -1, PS_ZEROING_BEST_MOVE = 2
+};
+
+typedef uint16_t Sym; // Huffman symbol
+
+// A binary tree node of the recursive pairing, packed in 3 bytes as two
+// 12-bit symbols.
+typedef struct {
+  uint8_t lr[3];
+} LR;
+
+INLINE Sym lr_left(const LR *lr)
+{
+  return ((lr->lr[1] & 0xF) << 8) | lr->lr[0];
+}
+
+INLINE Sym lr_right(const LR *lr)
+{
+  return (lr->lr[2] << 4) | (lr->lr[1] >> 4);
+}
+
+// The sparse index gives for each span of positions the block and the
+// offset in it at which the middle position of the span is stored.
+typedef struct {
+  uint8_t block[4];
+  uint8_t offset[2];
+} SparseEntry;
+
+// PairsData holds the decompression and encoding data of one side and, for
+// tables with pawns, one file of the leading pawn.
+typedef struct {
+  uint8_t flags;
+  size_t sizeofBlock;
+  size_t span;
+  int numBlocks;
+  int maxSymLen;
+  int minSymLen;
+  size_t numIndices;
+  SparseEntry *sparseIndex;
+  uint16_t *blockLength;
+  int blockLengthSize;
+  uint8_t *data;
+  uint64_t *base64;
+  uint8_t *symlen;
+  int numSyms;
+  const uint8_t *lowestSym;
+  const LR *btree;
+  uint8_t pieces[TBPIECES];
+  uint64_t groupIdx[TBPIECES + 1];
+  int groupLen[TBPIECES + 1];
+  uint16_t mapIdx[4];
+} PairsData;
+
+// A TBTable is a WDL or DTZ table. The file is mapped on first use. WDL
+// tables store both sides to move, DTZ tables only one.
+typedef struct {
+  atomic_bool ready;
+  uint8_t type;
+  const void *baseAddress;
+  map_t mapping;
+  uint8_t *map;
+  Key key, key2;
+  int pieceCount;
+  bool hasPawns;
+  bool hasUniquePieces;
+  uint8_t pawnCount[2];
+  PairsData items[2][4];
+} TBTable;
+
+// The tables are found by material key in a hash table with linear probing.
+// Up to 7 pieces there are 1511 tables with at most two keys each, so the
+// hash table never fills up.
+enum { TBHashBits = 12, TBHashSize = 1 << TBHashBits };
+
+typedef struct {
+  Key key;
+  TBTable *wdl;
+  TBTable *dtz;
+} TBHashEntry;
+
+static TBHashEntry tbHash[TBHashSize];
+static TBTable *tbTables;
+static int numTables, maxTables;
+
+static char *paths;
+static LOCK_T tbMutex;
+
+static int MapPawns[64];
+static int MapB1H1H7[64];
+static int MapA1D1D4[64];
+static int MapKK[10][64];
+static uint64_t Binomial[6][64];
+static uint64_t LeadPawnIdx[6][64];
+static uint64_t LeadPawnsSize[6][4];
+
+INLINE int off_A1H8(Square s)
+{
+  return (int)rank_of(s) - (int)file_of(s);
+}
+
+INLINE int edge_distance(int f)
+{
+  return min(f, FILE_H - f);
+}
+
+INLINE PairsData *tb_get(TBTable *e, int stm, int f)
+{
+  return &e->items[e->type == WDL ? stm & 1 : 0][e->hasPawns ? f : 0];
+}
+
+static TBTable *tb_lookup(Key key, int type)
+{
+  for (int i = key >> (64 - TBHashBits); tbHash[i].wdl; i = (i + 1) & (TBHashSize - 1))
+    if (tbHash[i].key == key)
+      return type == WDL ? tbHash[i].wdl : tbHash[i].dtz;
+
+  return NULL;
+}
+
+static void tb_insert(Key key, TBTable *wdl, TBTable *dtz)
+{
+  int i = key >> (64 - TBHashBits);
+  while (tbHash[i].wdl && tbHash[i].key != key)
+    i = (i + 1) & (TBHashSize - 1);
+
+  tbHash[i].key = key;
+  tbHash[i].wdl = wdl;
+  tbHash[i].dtz = dtz;
+}
+
+// open_tb() looks for a table file in the directories of the SyzygyPath.
+
+static FD open_tb(const char *name)
+{
+#ifndef _WIN32
+  const char *sep = ":";
+#else
+  const char *sep = ";";
+#endif
+  char file[4096];
+  FD fd = FD_ERR;
+
+  for (const char *p = paths; fd == FD_ERR && *p; ) {
+    size_t len = strcspn(p, sep);
+    if (len > 0 && len + strlen(name) + 2 < sizeof(file)) {
+      snprintf(file, sizeof(file), "%.*s/%s", (int)len, p, name);
+      fd = open_file(file);
+    }
+    p += len + (p[len] != 0);
+  }
+
+  return fd;
+}
+
+// table_code() writes the pieces of a table for the given material key in
+// decreasing order, the side of key first, like "KRPvKR".
+
+static void table_code(const Position *pos, bool keySide, char *str)
+{
+  for (int c = 0; c < 2; c++) {
+    Color color = (c == 0) == keySide ? WHITE : BLACK;
+    for (int pt = KING; pt >= PAWN; pt--)
+      for (int i = 0; i < piece_count(color, pt); i++)
+        *str++ = PieceToChar[pt];
+    if (c == 0)
+      *str++ = 'v';
+  }
+  *str = 0;
+}
+
+// tb_add() adds the table with the given pieces, with the stronger side
+// first, like "KRvK", if its WDL file exists.
+
+// tb_set_material() fills in the material of a table from its piece types,
+// the stronger side first and each side starting with its king.
+
+static void tb_set_material(TBTable *e, const int *pcs, int n)
+{
+  Key key = 0, key2 = 0;
+
+  memset(e, 0, sizeof(*e));
+
+  // The second king starts the weaker side
+  int weak = 1;
+  while (pcs[weak] != KING)
+    weak++;
+
+  int pawns[2] = { 0, 0 };
+  int counts[2][8] = { { 0 } };
+  for (int i = 0; i < n; i++) {
+    int strong = i < weak;
+    key  += matKey[8 * (strong ? WHITE : BLACK) + pcs[i]];
+    key2 += matKey[8 * (strong ? BLACK : WHITE) + pcs[i]];
+    counts[!strong][pcs[i]]++;
+    pawns[!strong] += pcs[i] == PAWN;
+  }
+
+  e->type = WDL;
+  e->key = key;
+  e->key2 = key2;
+  e->pieceCount = n;
+  e->hasPawns = pawns[0] || pawns[1];
+  for (int c = 0; c < 2; c++)
+    for (int pt = PAWN; pt < KING; pt++)
+      if (counts[c][pt] == 1)
+        e->hasUniquePieces = true;
+
+  // The leading color is the side with less pawns, because this leads to
+  // better compression. The stronger side is white in the table.
+  bool lead =   !pawns[1]
+             || (pawns[0] && pawns[1] >= pawns[0]);
+  e->pawnCount[0] = lead ? pawns[0] : pawns[1];
+  e->pawnCount[1] = lead ? pawns[1] : pawns[0];
+}
+
+static void tb_add(const int *pcs, int n)
+{
+  char name[16];
+  int k = 0;
+
+  for (int i = 0; i < n; i++) {
+    if (i > 0 && pcs[i] == KING)
+      name[k++] = 'v';
+    name[k++] = PieceToChar[pcs[i]];
+  }
+  strcpy(name + k, ".rtbw");
+
+  FD fd = open_tb(name);
+  if (fd == FD_ERR)
+    return;
+  close_file(fd);
+
+  // The tables are referenced from the hash table by pointer, so they are
+  // allocated in one block that is large enough for all of them
+  if (numTables + 2 > maxTables)
+    return;
+
+  TBTable *wdl = &tbTables[numTables++];
+  TBTable *dtz = &tbTables[numTables++];
+  tb_set_material(wdl, pcs, n);
+  *dtz = *wdl;
+  dtz->type = DTZ;
+
+  TB_MaxCardinality = max(n, TB_MaxCardinality);
+
+  tb_insert(wdl->key, wdl, dtz);
+  tb_insert(wdl->key2, wdl, dtz);
+}
+
+// decompress_pairs() returns the value of position idx. The values are
+// compressed with Huffman coding of symbols that stand for a sequence of
+// values by recursive pairing. The sparse index leads close to the block
+// that holds idx, from where the symbols are decoded until the one that
+// contains idx. Then its pair tree is descended to the value.
+
+static int decompress_pairs(PairsData *d, uint64_t idx)
+{
+  if (d->flags & TB_SINGLE_VALUE)
+    return d->minSymLen;
+
+  uint32_t k = (uint32_t)(idx / d->span);
+  uint32_t block = readu_le_u32(&d->sparseIndex[k].block);
+  int offset = readu_le_u16(&d->sparseIndex[k].offset);
+
+  int diff = (int)(idx % d->span) - (int)(d->span / 2);
+  offset += diff;
+
+  while (offset < 0)
+    offset += d->blockLength[--block] + 1;
+
+  while (offset > d->blockLength[block])
+    offset -= d->blockLength[block++] + 1;
+
+  const uint32_t *ptr = (const uint32_t *)(d->data + (uint64_t)block * d->sizeofBlock);
+  uint64_t buf64 = from_be_u64(*(const uint64_t *)ptr);
+  ptr += 2;
+  int buf64Size = 64;
+  Sym sym;
+
+  while (true) {
+    int len = 0;
+
+    while (buf64 < d->base64[len])
+      len++;
+
+    sym = (Sym)((buf64 - d->base64[len]) >> (64 - len - d->minSymLen));
+    sym += readu_le_u16(d->lowestSym + 2 * len);
+
+    if (offset < d->symlen[sym] + 1)
+      break;
+
+    offset -= d->symlen[sym] + 1;
+    len += d->minSymLen;
+    buf64 <<= len;
+    buf64Size -= len;
+
+    if (buf64Size <= 32) {
+      buf64Size += 32;
+      buf64 |= (uint64_t)from_be_u32(*ptr++) << (64 - buf64Size);
+    }
+  }
+
+  while (d->symlen[sym]) {
+    Sym left = lr_left(&d->btree[sym]);
+
+    if (offset < d->symlen[left] + 1)
+      sym = left;
+    else {
+      offset -= d->symlen[left] + 1;
+      sym = lr_right(&d->btree[sym]);
+    }
+  }
+
+  return lr_left(&d->btree[sym]);
+}
+
+// check_dtz_stm() returns whether a DTZ table stores the side to move.
+
+static bool check_dtz_stm(TBTable *e, int stm, int f)
+{
+  if (e->type == WDL)
+    return true;
+
+  int flags = tb_get(e, stm, f)->flags;
+  return   (flags & TB_STM) == stm
+        || (e->key == e->key2 && !e->hasPawns);
+}
+
+// map_score() converts a stored value to a WDL score or a DTZ in plies.
+
+static int map_score(TBTable *e, int f, int value, int wdl)
+{
+  static const int WDLMap[] = { 1, 3, 0, 2, 0 };
+
+  if (e->type == WDL)
+    return value - 2;
+
+  PairsData *d = tb_get(e, 0, f);
+  int flags = d->flags;
+  uint8_t *map = e->map;
+  uint16_t *idx = d->mapIdx;
+
+  if (flags & TB_MAPPED) {
+    if (flags & TB_WIDE)
+      value = ((uint16_t *)map)[idx[WDLMap[wdl + 2]] + value];
+    else
+      value = map[idx[WDLMap[wdl + 2]] + value];
+  }
+
+  // DTZ tables store distance to zero in number of moves or plies. We
+  // want to return plies, so we have to convert to plies when needed.
+  if (   (wdl == WDL_WIN  && !(flags & TB_WIN_PLIES))
+      || (wdl == WDL_LOSS && !(flags & TB_LOSS_PLIES))
+      ||  wdl == WDL_CURSED_WIN
+      ||  wdl == WDL_BLESSED_LOSS)
+    value *= 2;
+
+  return value + 1;
+}
+
+INLINE bool pawns_less(Square i, Square j)
+{
+  return MapPawns[i] < MapPawns[j];
+}
+
+// sort_squares() is a stable insertion sort of a few squares, by square or
+// by MapPawns[].
+
+static void sort_squares(Square *sq, int n, bool byPawns)
+{
+  for (int i = 1; i < n; i++) {
+    Square s = sq[i];
+    int j = i;
+    for (; j > 0 && (byPawns ? pawns_less(s, sq[j - 1]) : s < sq[j - 1]); j--)
+      sq[j] = sq[j - 1];
+    sq[j] = s;
+  }
+}
+
+// tb_index() computes the index of the position in the table and sets the
+// subtable and the file of the leading pawn it belongs to. The pieces are
+// reordered and the board is mirrored in the same way as the generator
+// did, see set_groups(). It returns false if the table does not store the
+// side to move.
+
+INLINE bool tb_index(const Position *pos, TBTable *e, PairsData **dp,
+                     int *fp, uint64_t *ip)
+{
+  Square squares[TBPIECES];
+  Piece pcs[TBPIECES];
+  uint64_t idx;
+  int next = 0, size = 0, leadPawnsCnt = 0;
+  PairsData *d;
+  Bitboard b, leadPawns = 0;
+  int tbFile = FILE_A;
+
+  // A table like KRvK has two material keys, for KR being white and for KR
+  // being black. If both sides have the same pieces, the keys are equal and
+  // the table only stores white to move, so that for black to move we
+  // switch colors and flip the board.
+  bool symmetricBlackToMove = (e->key == e->key2 && stm());
+
+  // The tables store the stronger side as white
+  bool blackStronger = (material_key() != e->key);
+
+  int flipColor   = (symmetricBlackToMove || blackStronger) * 8;
+  int flipSquares = (symmetricBlackToMove || blackStronger) * 56;
+  int stmIdx      = (symmetricBlackToMove || blackStronger) ^ stm();
+
+  // For pawns, the tables are split in 4 according to the file of the
+  // leading pawn after mirroring. The leading pawn is the one with the
+  // highest MapPawns[], the one nearest to the edge and, among those on
+  // the same file, the one with the lowest rank.
+  if (e->hasPawns) {
+    // The pawns are at the start of the sequence of pieces in all 4
+    // tables and their color is the leading one.
+    Piece pc = tb_get(e, 0, 0)->pieces[0] ^ flipColor;
+
+    leadPawns = b = pieces_cp(color_of(pc), PAWN);
+    do
+      squares[size++] = pop_lsb(&b) ^ flipSquares;
+    while (b);
+
+    leadPawnsCnt = size;
+
+    int maxIdx = 0;
+    for (int i = 1; i < leadPawnsCnt; i++)
+      if (pawns_less(squares[maxIdx], squares[i]))
+        maxIdx = i;
+    Square tmp = squares[0];
+    squares[0] = squares[maxIdx];
+    squares[maxIdx] = tmp;
+
+    tbFile = edge_distance(file_of(squares[0]));
+  }
+
+  // DTZ tables only store one side to move
+  if (!check_dtz_stm(e, stmIdx, tbFile))
+    return false;
+
+  // Now get all the other pieces, mapped to the right color and square
+  b = pieces() ^ leadPawns;
+  do {
+    Square s = pop_lsb(&b);
+    squares[size] = s ^ flipSquares;
+    pcs[size++] = piece_on(s) ^ flipColor;
+  } while (b);
+
+  assert(size >= 2);
+
+  d = tb_get(e, stmIdx, tbFile);
+
+  // Reorder the pieces to the sequence of the table, the one that gives
+  // the best compression
+  for (int i = leadPawnsCnt; i < size - 1; i++)
+    for (int j = i + 1; j < size; j++)
+      if (d->pieces[i] == pcs[j]) {
+        Piece pc = pcs[i]; pcs[i] = pcs[j]; pcs[j] = pc;
+        Square sq = squares[i]; squares[i] = squares[j]; squares[j] = sq;
+        break;
+      }
+
+  // Map the square of the leading piece to the a1-d1-d4 triangle
+  if (file_of(squares[0]) > FILE_D)
+    for (int i = 0; i < size; i++)
+      squares[i] ^= 7;
+
+  // Encode the leading pawns, starting with the one with the lowest
+  // MapPawns[] and going up
+  if (e->hasPawns) {
+    idx = LeadPawnIdx[leadPawnsCnt][squares[0]];
+
+    sort_squares(squares + 1, leadPawnsCnt - 1, true);
+
+    for (int i = 1; i < leadPawnsCnt; i++)
+      idx += Binomial[i][MapPawns[squares[i]]];
+
+    goto encode_remaining;
+  }
+
+  // Without pawns, also map the leading piece below rank 5
+  if (rank_of(squares[0]) > RANK_4)
+    for (int i = 0; i < size; i++)
+      squares[i] ^= 56;
+
+  // Find the first piece of the leading group that is not on the a1-h8
+  // diagonal and make sure it is below it
+  for (int i = 0; i < d->groupLen[0]; i++) {
+    if (!off_A1H8(squares[i]))
+      continue;
+
+    if (off_A1H8(squares[i]) > 0) // Flip around the diagonal: a3 -> c1
+      for (int j = i; j < size; j++)
+        squares[j] = ((squares[j] >> 3) | (squares[j] << 3)) & 63;
+    break;
+  }
+
+  // Encode the leading group. With at least 3 unique pieces (the kings
+  // included) the first three are encoded together, otherwise only the
+  // kings are. There are 462 legal ways to place two kings with the first
+  // one in the a1-d1-d4 triangle.
+  if (e->hasUniquePieces) {
+    int adjust1 =  squares[1] > squares[0];
+    int adjust2 = (squares[2] > squares[0]) + (squares[2] > squares[1]);
+
+    // First piece below the a1-h8 diagonal. MapA1D1D4[] maps the b1-d1-d3
+    // triangle to 0...5. There are 63 squares for the second piece and 62
+    // for the third.
+    if (off_A1H8(squares[0]))
+      idx = (   MapA1D1D4[squares[0]]  * 63
+             + (squares[1] - adjust1)) * 62
+             +  squares[2] - adjust2;
+
+    // First piece on the diagonal, second below it: rank_of() maps the
+    // a1-d4 diagonal to 0...3 and MapB1H1H7[] the b1-h1-h7 triangle to
+    // 0...27.
+    else if (off_A1H8(squares[1]))
+      idx = (  6 * 63 + rank_of(squares[0]) * 28
+             + MapB1H1H7[squares[1]])       * 62
+             + squares[2] - adjust2;
+
+    // First two pieces on the diagonal, third below it
+    else if (off_A1H8(squares[2]))
+      idx =  6 * 63 * 62 + 4 * 28 * 62
+           +  rank_of(squares[0])            * 7 * 28
+           + (rank_of(squares[1]) - adjust1) * 28
+           +  MapB1H1H7[squares[2]];
+
+    // All three pieces on the diagonal
+    else
+      idx =  6 * 63 * 62 + 4 * 28 * 62 + 4 * 7 * 28
+           +  rank_of(squares[0])            * 7 * 6
+           + (rank_of(squares[1]) - adjust1) * 6
+           + (rank_of(squares[2]) - adjust2);
+  } else
+    idx = MapKK[MapA1D1D4[squares[0]]][squares[1]];
+
+encode_remaining:
+  idx *= d->groupIdx[0];
+  Square *groupSq = squares + d->groupLen[0];
+
+  // Encode the remaining pawns and then the pieces by ascending square
+  bool remainingPawns = e->hasPawns && e->pawnCount[1];
+
+  while (d->groupLen[++next]) {
+    sort_squares(groupSq, d->groupLen[next], false);
+    uint64_t n = 0;
+
+    // Map a square down for every square of the previous groups it comes
+    // after
+    for (int i = 0; i < d->groupLen[next]; i++) {
+      int adjust = 0;
+      for (Square *s = squares; s < groupSq; s++)
+        adjust += groupSq[i] > *s;
+      n += Binomial[i + 1][groupSq[i] - adjust - 8 * remainingPawns];
+    }
+
+    remainingPawns = false;
+    idx += n * d->groupIdx[next];
+    groupSq += d->groupLen[next];
+  }
+
+  *dp = d;
+  *fp = tbFile;
+  *ip = idx;
+  return true;
+}
+
+// do_probe_table() returns the value of the position in the table.
+
+static int do_probe_table(const Position *pos, TBTable *e, int wdl, int *result)
+{
+  PairsData *d;
+  int tbFile;
+  uint64_t idx;
+
+  if (!tb_index(pos, e, &d, &tbFile, &idx)) {
+    *result = PS_CHANGE_STM;
+    return 0;
+  }
+
+  return map_score(e, tbFile, decompress_pairs(d, idx), wdl);
+}
+
+// set_groups() splits the pieces of a table into groups of pieces of the
+// same kind, except for the leading group. If the pieces of group g can be
+// placed in N(g) ways, the position is encoded as
+//
+//   g1 * N(g2) * N(g3) + g2 * N(g3) + g3
+//
+// The order of the groups is stored in the table. The leading group is at
+// order[0] and the remaining pawns, if any, at order[1].
+
+static void set_groups(TBTable *e, PairsData *d, int order[2], int f)
+{
+  int n = 0, firstLen = e->hasPawns ? 0 : e->hasUniquePieces ? 3 : 2;
+  d->groupLen[n] = 1;
+
+  for (int i = 1; i < e->pieceCount; i++)
+    if (--firstLen > 0 || d->pieces[i] == d->pieces[i - 1])
+      d->groupLen[n]++;
+    else
+      d->groupLen[++n] = 1;
+
+  d->groupLen[++n] = 0; // Zero-terminated
+
+  bool pp = e->hasPawns && e->pawnCount[1]; // Pawns on both sides
+  int next = pp ? 2 : 1;
+  int freeSquares = 64 - d->groupLen[0] - (pp ? d->groupLen[1] : 0);
+  uint64_t idx = 1;
+
+  for (int k = 0; next < n || k == order[0] || k == order[1]; k++)
+    if (k == order[0]) { // Leading pawns or pieces
+      d->groupIdx[0] = idx;
+      idx *=  e->hasPawns ? LeadPawnsSize[d->groupLen[0]][f]
+            : e->hasUniquePieces ? 31332 : 462;
+    }
+    else if (k == order[1]) { // Remaining pawns
+      d->groupIdx[1] = idx;
+      idx *= Binomial[d->groupLen[1]][48 - d->groupLen[0]];
+    }
+    else { // Remaining pieces
+      d->groupIdx[next] = idx;
+      idx *= Binomial[d->groupLen[next]][freeSquares];
+      freeSquares -= d->groupLen[next++];
+    }
+
+  d->groupIdx[n] = idx;
+}
+
+// set_symlen() computes the number of values a symbol stands for, minus
+// one, by descending its pair tree.
+
+static uint8_t set_symlen(PairsData *d, Sym s, uint8_t *visited)
+{
+  visited[s] = 1; // The tree is acyclic
+  Sym sr = lr_right(&d->btree[s]);
+
+  if (sr == 0xFFF)
+    return 0;
+
+  Sym sl = lr_left(&d->btree[s]);
+
+  if (!visited[sl])
+    d->symlen[sl] = set_symlen(d, sl, visited);
+
+  if (!visited[sr])
+    d->symlen[sr] = set_symlen(d, sr, visited);
+
+  return d->symlen[sl] + d->symlen[sr] + 1;
+}
+
+// set_sizes() reads the sizes and the Huffman code of a PairsData and
+// returns the data that follows.
+
+static uint8_t *set_sizes(PairsData *d, uint8_t *data)
+{
+  d->flags = *data++;
+
+  if (d->flags & TB_SINGLE_VALUE) {
+    d->numBlocks = d->span = d->numIndices = d->maxSymLen = 0;
+    d->minSymLen = *data++; // The single value
+    return data;
+  }
+
+  // The last groupIdx[] is the size of the table
+  int last = 0;
+  while (d->groupLen[last])
+    last++;
+  uint64_t tbSize = d->groupIdx[last];
+
+  d->sizeofBlock = 1ULL << *data++;
+  d->span = 1ULL << *data++;
+  d->numIndices = (tbSize + d->span - 1) / d->span; // Round up
+  int padding = *data++;
+  d->numBlocks = readu_le_u32(data);
+  data += sizeof(uint32_t);
+  // Padded so that the sparse index does not point out of range
+  d->blockLengthSize = d->numBlocks + padding;
+  d->maxSymLen = *data++;
+  d->minSymLen = *data++;
+  d->lowestSym = data;
+  int base64Size = d->maxSymLen - d->minSymLen + 1;
+  d->base64 = calloc(base64Size, sizeof(uint64_t));
+
+  // The canonical Huffman code gives longer codes lower values, so that
+  // lowestSym[i] >= lowestSym[i + 1]. From this, base64[i] is the lowest
+  // 64-bit left-aligned code of length i + minSymLen.
+  for (int i = base64Size - 2; i >= 0; i--)
+    d->base64[i] = (  d->base64[i + 1] + readu_le_u16(d->lowestSym + 2 * i)
+                    - readu_le_u16(d->lowestSym + 2 * (i + 1))) / 2;
+
+  for (int i = 0; i < base64Size; i++)
+    d->base64[i] <<= 64 - i - d->minSymLen; // Right-padding to 64 bits
+
+  data += base64Size * sizeof(Sym);
+  d->numSyms = readu_le_u16(data);
+  data += sizeof(uint16_t);
+  d->btree = (const LR *)data;
+  d->symlen = calloc(d->numSyms, 1);
+
+  uint8_t *visited = calloc(d->numSyms, 1);
+  for (int s = 0; s < d->numSyms; s++)
+    if (!visited[s])
+      d->symlen[s] = set_symlen(d, s, visited);
+  free(visited);
+
+  return data + d->numSyms * sizeof(LR) + (d->numSyms & 1);
+}
+
+// set_dtz_map() sets the maps that DTZ tables use to store their values
+// in fewer bits.
+
+static uint8_t *set_dtz_map(TBTable *e, uint8_t *data, int maxFile)
+{
+  if (e->type == WDL)
+    return data;
+
+  e->map = data;
+
+  for (int f = FILE_A; f <= maxFile; f++) {
+    PairsData *d = tb_get(e, 0, f);
+    if (d->flags & TB_MAPPED) {
+      if (d->flags & TB_WIDE) {
+        data += (uintptr_t)data & 1; // Word alignment
+        for (int i = 0; i < 4; i++) { // Sequence like 3,x,x,x,1,x,0,2,x,x
+          d->mapIdx[i] = (uint16_t)((uint16_t *)data - (uint16_t *)e->map + 1);
+          data += 2 * readu_le_u16(data) + 2;
+        }
+      }
+      else {
+        for (int i = 0; i < 4; i++) {
+          d->mapIdx[i] = (uint16_t)(data - e->map + 1);
+          data += *data + 1;
+        }
+      }
+    }
+  }
+
+  return data + ((uintptr_t)data & 1); // Word alignment
+}
+
+// init_table() sets up a table from its mapped file.
+
+static void init_table(TBTable *e, uint8_t *data)
+{
+  PairsData *d;
+
+  data++; // The first byte stores flags
+
+  const int sides = e->type == WDL && e->key != e->key2 ? 2 : 1;
+  const int maxFile = e->hasPawns ? FILE_D : FILE_A;
+
+  bool pp = e->hasPawns && e->pawnCount[1]; // Pawns on both sides
+
+  for (int f = FILE_A; f <= maxFile; f++) {
+    for (int i = 0; i < sides; i++)
+      memset(tb_get(e, i, f), 0, sizeof(PairsData));
+
+    int order[2][2] = { { *data & 0xF, pp ? *(data + 1) & 0xF : 0xF },
+                        { *data >>  4, pp ? *(data + 1) >>  4 : 0xF } };
+    data += 1 + pp;
+
+    for (int k = 0; k < e->pieceCount; k++, data++)
+      for (int i = 0; i < sides; i++)
+        tb_get(e, i, f)->pieces[k] = i ? *data >> 4 : *data & 0xF;
+
+    for (int i = 0; i < sides; i++)
+      set_groups(e, tb_get(e, i, f), order[i], f);
+  }
+
+  data += (uintptr_t)data & 1; // Word alignment
+
+  for (int f = FILE_A; f <= maxFile; f++)
+    for (int i = 0; i < sides; i++)
+      data = set_sizes(tb_get(e, i, f), data);
+
+  data = set_dtz_map(e, data, maxFile);
+
+  for (int f = FILE_A; f <= maxFile; f++)
+    for (int i = 0; i < sides; i++) {
+      (d = tb_get(e, i, f))->sparseIndex = (SparseEntry *)data;
+      data += d->numIndices * sizeof(SparseEntry);
+    }
+
+  for (int f = FILE_A; f <= maxFile; f++)
+    for (int i = 0; i < sides; i++) {
+      (d = tb_get(e, i, f))->blockLength = (uint16_t *)data;
+      data += d->blockLengthSize * sizeof(uint16_t);
+    }
+
+  for (int f = FILE_A; f <= maxFile; f++)
+    for (int i = 0; i < sides; i++) {
+      data = (uint8_t *)(((uintptr_t)data + 0x3F) & ~0x3F); // 64-byte alignment
+      (d = tb_get(e, i, f))->data = data;
+      data += d->numBlocks * d->sizeofBlock;
+    }
+}
+
+// map_table() maps the file of a table the first time it is probed. The
+// files are mapped read-only and shared, so all threads use one mapping
+// and processes share the pages through the page cache.
+
+static bool map_table(TBTable *e, const Position *pos)
+{
+  static const uint8_t Magics[2][4] = {
+    { 0x71, 0xE8, 0x23, 0x5D }, // WDL
+    { 0xD7, 0x66, 0x0C, 0xA5 }  // DTZ
+  };
+
+  if (atomic_load_explicit(&e->ready, memory_order_acquire))
+    return e->baseAddress != NULL; // NULL if the file does not exist
+
+  LOCK(tbMutex);
+
+  if (!atomic_load_explicit(&e->ready, memory_order_relaxed)) {
+    char name[24];
+    table_code(pos, e->key == material_key(), name);
+    strcat(name, e->type == WDL ? ".rtbw" : ".rtbz");
+
+    FD fd = open_tb(name);
+    if (fd != FD_ERR) {
+      size_t size = file_size(fd);
+      if (size % 64 != 16)
+        fprintf(stderr, "Corrupt tablebase file %s\n", name);
+      else if ((e->baseAddress = map_file(fd, &e->mapping))
+               && memcmp(e->baseAddress, Magics[e->type], 4))
+      {
+        fprintf(stderr, "Corrupted table in file %s\n", name);
+        unmap_file(e->baseAddress, e->mapping);
+        e->baseAddress = NULL;
+      }
+      close_file(fd);
+
+      if (e->baseAddress)
+        init_table(e, (uint8_t *)e->baseAddress + 4);
+    }
+
+    atomic_store_explicit(&e->ready, true, memory_order_release);
+  }
+
+  UNLOCK(tbMutex);
+
+  return e->baseAddress != NULL;
+}
+
+static int probe_table(const Position *pos, int type, int *result, int wdl)
+{
+  if (popcount(pieces()) == 2) // KvK
+    return WDL_DRAW;
+
+  TBTable *e = tb_lookup(material_key(), type);
+
+  if (!e || !map_table(e, pos)) {
+    *result = PS_FAIL;
+    return 0;
+  }
+
+  return do_probe_table(pos, e, wdl, result);
+}
+
+// probe_search() probes the WDL table, after resolving the captures, and
+// with checkZeroing also the pawn moves. The tables do not store positions
+// with en passant rights, and for some positions with only captures the
+// stored value may be wrong, so the captures have to be searched. It sets
+// result to PS_ZEROING_BEST_MOVE if the best move zeroes the 50-move
+// counter.
+
+static int probe_search(Position *pos, int *result, bool checkZeroing)
+{
+  int value, bestValue = WDL_LOSS;
+  ExtMove list[MAX_MOVES];
+
+  ExtMove *last = generate_legal(pos, list);
+  int totalCount = last - list, moveCount = 0;
+
+  for (ExtMove *m = list; m < last; m++) {
+    Move move = m->move;
+    if (   !is_capture(pos, move)
+        && (!checkZeroing || type_of_p(moved_piece(move)) != PAWN))
+      continue;
+
+    moveCount++;
+
+    do_move(pos, move, gives_check(pos, pos->st, move));
+    value = -probe_search(pos, result, false);
+    undo_move(pos, move);
+
+    if (*result == PS_FAIL)
+      return WDL_DRAW;
+
+    if (value > bestValue) {
+      bestValue = value;
+
+      if (value >= WDL_WIN) {
+        *result = PS_ZEROING_BEST_MOVE; // Winning DTZ-zeroing move
+        return value;
+      }
+    }
+  }
+
+  // If all legal moves have been searched, the table need not be probed,
+  // and its value could be wrong.
+  bool noMoreMoves = moveCount && moveCount == totalCount;
+
+  if (noMoreMoves)
+    value = bestValue;
+  else {
+    value = probe_table(pos, WDL, result, WDL_DRAW);
+
+    if (*result == PS_FAIL)
+      return WDL_DRAW;
+  }
+
+  // DTZ stores a "don't care" value if bestValue is a win
+  if (bestValue >= value) {
+    *result = bestValue > WDL_DRAW || noMoreMoves ? PS_ZEROING_BEST_MOVE : PS_OK;
+    return bestValue;
+  }
+
+  *result = PS_OK;
+  return value;
+}
+
+// TB_probe_wdl() probes the WDL tables for the position. The position must
+// not have castling rights. It returns the WDL score from the point of
+// view of the side to move and sets success to 0 if the probe failed.
+
+int TB_probe_wdl(Position *pos, int *success)
+{
+  *success = PS_OK;
+  return probe_search(pos, success, false);
+}
+
+// dtz_before_zeroing() returns the DTZ of a move that zeroes the 50-move
+// counter and leads to a position with the given WDL score.
+
+static int dtz_before_zeroing(int wdl)
+{
+  return  wdl == WDL_WIN         ?  1
+        : wdl == WDL_CURSED_WIN  ?  101
+        : wdl == WDL_BLESSED_LOSS ? -101
+        : wdl == WDL_LOSS        ? -1 : 0;
+}
+
+INLINE int sign_of(int v)
+{
+  return (v > 0) - (v < 0);
+}
+
+// TB_probe_dtz() probes the DTZ tables for the position. The position must
+// not have castling rights. It returns the distance to a zeroing move in
+// plies, positive for a win and negative for a loss, or 0 for a draw. A
+// DTZ of n means that a zeroing move is reached in n plies with the best
+// play of the winning side, or that a win or loss is within reach in n
+// plies for cursed wins and blessed losses with 100 added.
+//
+// For cursed wins and blessed losses the DTZ may be off by one if the 50
+// moves are counted from the last zeroing move.
+
+int TB_probe_dtz(Position *pos, int *success)
+{
+  *success = PS_OK;
+  int wdl = probe_search(pos, success, true);
+
+  if (*success == PS_FAIL || wdl == WDL_DRAW) // DTZ tables do not store draws
+    return 0;
+
+  // DTZ stores a "don't care" value in this case, or even a plain wrong one
+  // as when the best move is a losing en passant capture, so it cannot be
+  // probed.
+  if (*success == PS_ZEROING_BEST_MOVE)
+    return dtz_before_zeroing(wdl);
+
+  int dtz = probe_table(pos, DTZ, success, wdl);
+
+  if (*success == PS_FAIL)
+    return 0;
+
+  if (*success != PS_CHANGE_STM)
+    return (dtz + 100 * (wdl == WDL_BLESSED_LOSS || wdl == WDL_CURSED_WIN)) * sign_of(wdl);
+
+  // The DTZ table stores the other side to move, so do a 1-ply search and
+  // find the winning move that minimises DTZ.
+  int minDTZ = 0xFFFF;
+  ExtMove list[MAX_MOVES];
+  ExtMove *last = generate_legal(pos, list);
+
+  for (ExtMove *m = list; m < last; m++) {
+    Move move = m->move;
+    bool zeroing = is_capture(pos, move) || type_of_p(moved_piece(move)) == PAWN;
+
+    do_move(pos, move, gives_check(pos, pos->st, move));
+
+    // For zeroing moves we want the DTZ of the move before doing it, not of
+    // the next sequence. The position after the move is searched to get the
+    // sign of the score, as even in a won position a capture may lose or
+    // draw.
+    dtz = zeroing ? -dtz_before_zeroing(probe_search(pos, success, false))
+                  : -TB_probe_dtz(pos, success);
+
+    // If the move mates, force minDTZ to 1
+    if (dtz == 1 && checkers()) {
+      ExtMove replies[MAX_MOVES];
+      if (generate_legal(pos, replies) == replies)
+        minDTZ = 1;
+    }
+
+    // Convert the result of the 1-ply search. Zeroing moves are already
+    // accounted for by dtz_before_zeroing().
+    if (!zeroing)
+      dtz += sign_of(dtz);
+
+    // Skip the draws and, when winning, only pick positive DTZ
+    if (dtz < minDTZ && sign_of(dtz) == sign_of(wdl))
+      minDTZ = dtz;
+
+    undo_move(pos, move);
+
+    if (*success == PS_FAIL)
+      return 0;
+  }
+
+  // Without legal moves the position is mate
+  return minDTZ == 0xFFFF ? -1 : minDTZ;
+}
+
+// root_probe() ranks the root moves by DTZ. Wins are ranked equally unless
+// the 50-move rule comes into sight, losses are ranked by how far the
+// 50-move draw is. It returns false if a table is missing.
+
+static bool root_probe(Position *pos, RootMoves *rm)
+{
+  int success;
+
+  // The 50-move counter at the root and whether a position has repeated
+  // since the last zeroing move
+  int cnt50 = rule50_count();
+  bool rep = pos->hasRepeated;
+
+  int dtz, bound = TB_UseRule50 ? 900 : 1;
+
+  for (int i = 0; i < rm->size; i++) {
+    RootMove *m = &rm->move[i];
+    do_move(pos, m->pv[0], gives_check(pos, pos->st, m->pv[0]));
+
+    // Calculate DTZ for the move counting from the root position
+    if (rule50_count() == 0) {
+      // A zeroing move has DTZ -101, -1, 0, 1 or 101
+      int wdl = -TB_probe_wdl(pos, &success);
+      dtz = dtz_before_zeroing(wdl);
+    } else {
+      // Otherwise take the DTZ of the new position, corrected by one ply
+      dtz = -TB_probe_dtz(pos, &success);
+      dtz =  dtz > 0 ? dtz + 1
+           : dtz < 0 ? dtz - 1 : dtz;
+    }
+
+    // A mating move gets DTZ 1
+    if (checkers() && dtz == 2) {
+      ExtMove replies[MAX_MOVES];
+      if (generate_legal(pos, replies) == replies)
+        dtz = 1;
+    }
+
+    undo_move(pos, m->pv[0]);
+
+    if (!success)
+      return false;
+
+    // Better moves are ranked higher. Certain wins are ranked equally.
+    // Losing moves are ranked equally unless a 50-move draw is in sight.
+    int r =  dtz > 0 ? (dtz + cnt50 <= 99 && !rep ? 1000 : 1000 - (dtz + cnt50))
+           : dtz < 0 ? (-dtz * 2 + cnt50 < 100 ? -1000 : -1000 + (-dtz + cnt50))
+           : 0;
+    m->tbRank = r;
+
+    // The score of the move. Cursed wins get at least 1 cp, which grows to
+    // 49 cp as the position gets closer to a real win.
+    m->tbScore =  r >= bound ? VALUE_MATE - MAX_PLY - 1
+                : r >  0     ? (max( 3, r - 800) * PawnValueEg) / 200
+                : r == 0     ? VALUE_DRAW
+                : r > -bound ? (min(-3, r + 800) * PawnValueEg) / 200
+                :             -VALUE_MATE + MAX_PLY + 1;
+  }
+
+  return true;
+}
+
+// root_probe_wdl() ranks the root moves by WDL, for when the DTZ tables
+// are missing. It returns false if a table is missing.
+
+static bool root_probe_wdl(Position *pos, RootMoves *rm)
+{
+  static const int WDL_to_rank[] = { -1000, -899, 0, 899, 1000 };
+  static const Value WDL_to_value[] = {
+    -VALUE_MATE + MAX_PLY + 1, VALUE_DRAW - 2, VALUE_DRAW, VALUE_DRAW + 2,
+     VALUE_MATE - MAX_PLY - 1
+  };
+
+  int success;
+
+  for (int i = 0; i < rm->size; i++) {
+    RootMove *m = &rm->move[i];
+    do_move(pos, m->pv[0], gives_check(pos, pos->st, m->pv[0]));
+    int wdl = -TB_probe_wdl(pos, &success);
+    undo_move(pos, m->pv[0]);
+
+    if (!success)
+      return false;
+
+    m->tbRank = WDL_to_rank[wdl + 2];
+
+    if (!TB_UseRule50)
+      wdl =  wdl > WDL_DRAW ? WDL_WIN
+           : wdl < WDL_DRAW ? WDL_LOSS : WDL_DRAW;
+    m->tbScore = WDL_to_value[wdl + 2];
+  }
+
+  return true;
+}
+
+// TB_rank_root_moves() ranks the root moves by the tables if the root
+// position is in them. Only the best ranked moves are then searched. The
+// search itself probes the WDL tables only if the DTZ tables are missing
+// and the root position is not lost.
+
+void TB_rank_root_moves(Position *pos, RootMoves *rm)
+{
+  TB_RootInTB = false;
+  TB_UseRule50 = option_value(OPT_SYZ_50_MOVE);
+  TB_ProbeDepth = option_value(OPT_SYZ_PROBE_DEPTH);
+  TB_Cardinality = option_value(OPT_SYZ_PROBE_LIMIT);
+  bool dtzAvailable = true;
+
+  // Tables with fewer pieces than SyzygyProbeLimit are probed at any depth
+  if (TB_Cardinality > TB_MaxCardinality) {
+    TB_Cardinality = TB_MaxCardinality;
+    TB_ProbeDepth = 0;
+  }
+
+  if (TB_Cardinality >= popcount(pieces()) && !can_castle_any()) {
+    // Rank the moves with the DTZ tables
+    TB_RootInTB = root_probe(pos, rm);
+
+    if (!TB_RootInTB) {
+      // The DTZ tables are missing, try the WDL tables
+      dtzAvailable = false;
+      TB_RootInTB = root_probe_wdl(pos, rm);
+    }
+  }
+
+  if (TB_RootInTB) {
+    // Sort the moves by rank, keeping the order of equal ones
+    for (int i = 1; i < rm->size; i++) {
+      RootMove tmp = rm->move[i];
+      int j = i;
+      for (; j > 0 && rm->move[j - 1].tbRank < tmp.tbRank; j--)
+        rm->move[j] = rm->move[j - 1];
+      rm->move[j] = tmp;
+    }
+
+    // Probe during the search only if DTZ is missing and we do not lose
+    if (dtzAvailable || rm->move[0].tbScore <= VALUE_DRAW)
+      TB_Cardinality = 0;
+  }
+  else
+    for (int i = 0; i < rm->size; i++)
+      rm->move[i].tbRank = 0;
+}
+
+// The tbcheck command tests the decoding of the tables without known
+// results to compare with: a position must have the WDL value of its best
+// move, its DTZ must match the WDL value and, for wins, the DTZ after the
+// best move, and the colour-flipped and mirrored positions must have the
+// same values. A decoding error breaks these relations almost at once.
+
+// board_to_fen() writes a 'position fen' argument for the board, indexed
+// by square, with the given side to move.
+
+static void board_to_fen(const char *board, Color c, char *cmd)
+{
+  char *s = cmd + sprintf(cmd, "fen ");
+
+  for (int r = 7; r >= 0; r--) {
+    int empty = 0;
+    for (int f = 0; f < 8; f++) {
+      char p = board[8 * r + f];
+      if (!p)
+        empty++;
+      else {
+        if (empty)
+          *s++ = '0' + empty, empty = 0;
+        *s++ = p;
+      }
+    }
+    if (empty)
+      *s++ = '0' + empty;
+    if (r > 0)
+      *s++ = '/';
+  }
+  sprintf(s, " %c - - 0 1", c == WHITE ? 'w' : 'b');
+}
+
+// tb_check_setup() sets up the board. It returns false if the side to
+// move can capture the king.
+
+static bool tb_check_setup(Position *pos, const char *board, Color c)
+{
+  char cmd[128];
+
+  board_to_fen(board, c, cmd);
+  position(pos, cmd);
+
+  return !(attackers_to(square_of(!stm(), KING)) & pieces_c(stm()));
+}
+
+// tb_check_probe() probes the position. It returns false if a probe failed.
+
+static bool tb_check_probe(Position *pos, int *wdl, int *dtz)
+{
+  int s1, s2;
+
+  *wdl = TB_probe_wdl(pos, &s1);
+  *dtz = TB_probe_dtz(pos, &s2);
+
+  return s1 && s2;
+}
+
+// tb_check_moves() checks the WDL and DTZ values of the position against
+// those after its moves. It returns false if a probe failed.
+
+static bool tb_check_moves(Position *pos, int wdl, int dtz, bool *wdlOk,
+                           bool *dtzOk)
+{
+  ExtMove list[MAX_MOVES];
+  ExtMove *last = generate_legal(pos, list);
+  int best = last == list ? (checkers() ? WDL_LOSS : WDL_DRAW) : -3;
+  int success;
+
+  *dtzOk = sign_of(dtz) == sign_of(wdl);
+  bool step = wdl != WDL_WIN;
+
+  for (ExtMove *m = list; m < last; m++) {
+    Move move = m->move;
+    bool zeroing = is_capture(pos, move) || type_of_p(moved_piece(move)) == PAWN;
+
+    do_move(pos, move, gives_check(pos, pos->st, move));
+    ExtMove replies[MAX_MOVES];
+    bool noMoves = generate_legal(pos, replies) == replies;
+    bool mate = noMoves && checkers();
+    int v = mate ? WDL_WIN : noMoves ? WDL_DRAW : -TB_probe_wdl(pos, &success);
+    success |= noMoves;
+    int d = success && !zeroing && !noMoves ? -TB_probe_dtz(pos, &success) : 0;
+    undo_move(pos, move);
+
+    if (!success)
+      return false;
+
+    best = max(best, v);
+
+    // A winning zeroing move or mate has a DTZ of 1, a winning quiet move
+    // one more than the position after it. DTZ may be rounded by one.
+    if (v == WDL_WIN)
+      step |= (zeroing || mate) ? dtz <= 2 : d > 0 && abs(d + 1 - dtz) <= 1;
+  }
+
+  *wdlOk = sign_of(best) == sign_of(wdl);
+  *dtzOk = *dtzOk && step;
+
+  return true;
+}
+
+// tb_check_board() places the pieces at random, the pawns off the first
+// and last ranks, and returns a random side to move.
+
+static Color tb_check_board(PRNG *rng, const char *pcs, int n, char *board)
+{
+  memset(board, 0, 64);
+
+  for (int i = 0; i < n; i++) {
+    int lo = tolower(pcs[i]) == 'p' ? 8 : 0, hi = lo ? 56 : 64, s;
+    do
+      s = lo + prng_rand(rng) % (hi - lo);
+    while (board[s]);
+    board[s] = pcs[i];
+  }
+
+  return prng_rand(rng) & 1;
+}
+
+// tb_check_class() returns a key that is the same for all positions that
+// the tables treat as one: the colour-flipped position and the position
+// mirrored left to right and, without pawns, also the positions mirrored
+// top to bottom and along the a1-h8 diagonal.
+
+static uint64_t tb_check_class(const char *board, Color c, bool pawns)
+{
+  uint64_t best = ~0ULL;
+
+  for (int flip = 0; flip < 2; flip++)
+    for (int t = 0; t < (pawns ? 2 : 8); t++) {
+      uint64_t h = 14695981039346656037ULL ^ (c ^ flip);
+      for (int s = 0; s < 64; s++) {
+        int f = s & 7, r = (s >> 3) ^ (flip ? 7 : 0);
+        if (t & 1) f ^= 7;
+        if (t & 2) r ^= 7;
+        if (t & 4) { int x = f; f = r; r = x; }
+        char p = board[8 * r + f];
+        h = (h ^ (uint8_t)(flip && p ? p ^ 0x20 : p)) * 1099511628211ULL;
+      }
+      best = min(best, h);
+    }
+
+  return best;
+}
+
+// tb_check_index() checks the index computation of tb_index() without the
+// tables. It lays out the pieces of the material as the generator does and
+// checks that each index is inside its subtable and that two positions
+// only share an index if the tables treat them as one. With num 0 it runs
+// through all placements of up to 4 pieces and also checks that each
+// index of a subtable is used.
+
+static void tb_check_index(Position *pos, const char *token, const char *pcs,
+                           int n, int num)
+{
+  int types[TBPIECES], cnt[16] = { 0 }, k = 0;
+  Piece seq[TBPIECES];
+  TBTable e;
+
+  // The stronger side first and each side starting with its king
+  for (int c = 0; c < 2; c++) {
+    types[k++] = KING;
+    for (int i = 0; i < n; i++)
+      if ((bool)islower(pcs[i]) == c && toupper(pcs[i]) != 'K')
+        types[k++] = strchr(PieceToChar, toupper(pcs[i])) - PieceToChar;
+  }
+  for (int i = 0; i < n; i++)
+    cnt[strchr(PieceToChar, pcs[i]) - PieceToChar]++;
+
+  if (k != n || cnt[W_KING] != 1 || cnt[B_KING] != 1 || (!num && n > 4)) {
+    printf("info string Each side needs one king and 'all' takes up to"
+           " 4 pieces\n");
+    fflush(stdout);
+    return;
+  }
+  tb_set_material(&e, types, n);
+
+  // The leading pawns or the two kings and a unique piece come first, then
+  // the remaining pawns and the other pieces in groups of the same kind
+  k = 0;
+  if (e.hasPawns) {
+    Color lead = cnt[W_PAWN] == e.pawnCount[0] ? WHITE : BLACK;
+    for (int i = 0; i < e.pawnCount[0]; i++)
+      seq[k++] = make_piece(lead, PAWN);
+    for (int i = 0; i < e.pawnCount[1]; i++)
+      seq[k++] = make_piece(!lead, PAWN);
+    cnt[W_PAWN] = cnt[B_PAWN] = 0;
+  } else {
+    seq[k++] = W_KING;
+    seq[k++] = B_KING;
+    cnt[W_KING] = cnt[B_KING] = 0;
+    for (Piece pc = W_KNIGHT; e.hasUniquePieces && k < 3; pc++)
+      if (cnt[pc] == 1)
+        seq[k++] = pc, cnt[pc] = 0;
+  }
+  for (Piece pc = 0; pc < 16; pc++)
+    for (; cnt[pc] > 0; cnt[pc]--)
+      seq[k++] = pc;
+
+  // Two kings that lead are only encoded on legal squares
+  bool kingsLead = !e.hasPawns && !e.hasUniquePieces;
+
+  // The class of the position at each index, in one array per subtable for
+  // all placements and in a hash table on index and subtable otherwise
+  int order[2] = { 0, e.hasPawns && e.pawnCount[1] ? 1 : 0xF };
+  uint64_t *classes[2][4] = { { NULL } }, size[2][4];
+  bool used[2][4] = { { false } }, noMemory = false;
+
+  for (int f = FILE_A; f <= FILE_D; f++)
+    for (int i = 0; i < 2; i++) {
+      PairsData *d = &e.items[i][f];
+      for (int j = 0; j < n; j++)
+        d->pieces[j] = seq[j];
+      set_groups(&e, d, order, f);
+      int g = 0;
+      while (d->groupLen[g])
+        g++;
+      size[i][f] = d->groupIdx[g];
+      if (!num && !(classes[i][f] = calloc(size[i][f], sizeof(uint64_t))))
+        noMemory = true;
+    }
+
+  size_t mask = 1;
+  while (num && mask < 2 * (size_t)num)
+    mask *= 2;
+  struct { uint64_t key, cls; } *seen = num ? calloc(mask--, sizeof(*seen))
+                                            : NULL;
+
+  if (noMemory || (num && !seen)) {
+    printf("info string Out of memory\n");
+    fflush(stdout);
+    goto done;
+  }
+
+  PRNG rng;
+  prng_init(&rng, 1070372);
+  int checked = 0, indices = 0, unused = 0, rangeErrors = 0, collisions = 0;
+  uint64_t code = 0, codes = 1ULL << (6 * n);
+
+  while (num ? checked < num && code++ < 100ULL * num : code < 2 * codes) {
+    char board[64] = { 0 };
+    Color c;
+
+    if (num) {
+      c = tb_check_board(&rng, pcs, n, board);
+      if (!tb_check_setup(pos, board, c))
+        continue;
+    } else {
+      // Count through all placements, each with both sides to move
+      uint64_t x = code % codes;
+      c = code++ / codes;
+      bool ok = true;
+      for (int i = 0; i < n && ok; i++, x >>= 6) {
+        ok = !board[x & 63] && (toupper(pcs[i]) != 'P' || (x & 63) - 8 < 48);
+        board[x & 63] = pcs[i];
+      }
+      if (!ok)
+        continue;
+      char cmd[128];
+      board_to_fen(board, c, cmd);
+      position(pos, cmd);
+      if (kingsLead && distance(square_of(WHITE, KING), square_of(BLACK, KING)) < 2)
+        continue;
+    }
+
+    PairsData *d;
+    int f;
+    uint64_t idx, *slot = NULL;
+    if (!tb_index(pos, &e, &d, &f, &idx))
+      continue;
+    int i = (d - &e.items[0][0]) / 4;
+    checked++;
+    used[i][f] = true;
+
+    bool ok = idx < size[i][f];
+    rangeErrors += !ok;
+
+    if (ok && !num)
+      slot = &classes[i][f][idx];
+    else if (ok) {
+      uint64_t key = (idx << 3 | (uint64_t)(d - &e.items[0][0])) + 1;
+      size_t h = (key * 0x9E3779B97F4A7C15ULL) & mask;
+      while (seen[h].key && seen[h].key != key)
+        h = (h + 1) & mask;
+      seen[h].key = key;
+      slot = &seen[h].cls;
+    }
+
+    uint64_t cls = tb_check_class(board, c, e.hasPawns);
+    if (slot && !*slot) {
+      *slot = cls;
+      indices++;
+    } else if (slot && *slot != cls) {
+      collisions++;
+      ok = false;
+    }
+
+    if (!ok && rangeErrors + collisions <= 10) {
+      char cmd[128];
+      board_to_fen(board, c, cmd);
+      printf("info string Bad index %" PRIu64 " %s\n", idx, cmd + 4);
+    }
+  }
+
+  for (int f = FILE_A; f <= FILE_D; f++)
+    for (int i = 0; i < 2; i++)
+      for (uint64_t j = 0; !num && used[i][f] && j < size[i][f]; j++)
+        unused += !classes[i][f][j];
+
+  printf("info string tbcheck index %s positions %d indices %d", token,
+         checked, indices);
+  if (!num)
+    printf(" unused %d", unused);
+  printf(" range errors %d collisions %d\n", rangeErrors, collisions);
+  fflush(stdout);
+
+done:
+  free(seen);
+  for (int f = FILE_A; f <= FILE_D; f++)
+    for (int i = 0; i < 2; i++)
+      free(classes[i][f]);
+}
+
+// tb_check_known() probes positions with known WDL values.
+
+static void tb_check_known(Position *pos)
+{
+  static const struct {
+    const char *fen;
+    int wdl;
+  } Known[] = {
+    { "4k3/8/4K3/4P3/8/8/8/8 w - - 0 1", WDL_WIN },        // KPvK, opposition
+    { "4k3/8/4K3/4P3/8/8/8/8 b - - 0 1", WDL_LOSS },
+    { "4k3/4P3/4K3/8/8/8/8/8 b - - 0 1", WDL_DRAW },       // Stalemate
+    { "k7/8/8/8/8/8/P7/7K w - - 0 1", WDL_DRAW },          // Rook pawn
+    { "7k/5Q2/6K1/8/8/8/8/8 b - - 0 1", WDL_DRAW },        // Stalemate
+    { "8/8/8/8/8/8/R7/K6k b - - 0 1", WDL_LOSS },          // KRvK
+    { "8/8/8/4k3/8/8/8/KB6 w - - 0 1", WDL_DRAW },         // KBvK
+    { "8/8/8/4k3/8/8/8/KNN5 w - - 0 1", WDL_DRAW },        // KNNvK
+    { "1K1k4/1P6/8/8/8/8/r7/2R5 w - - 0 1", WDL_WIN }      // Lucena
+  };
+  int checked = 0, missing = 0, errors = 0;
+
+  for (size_t i = 0; i < sizeof(Known) / sizeof(Known[0]); i++) {
+    char cmd[128];
+    int success;
+    snprintf(cmd, sizeof(cmd), "fen %s", Known[i].fen);
+    position(pos, cmd);
+    int wdl = TB_probe_wdl(pos, &success);
+    if (!success) {
+      missing++;
+      continue;
+    }
+    checked++;
+    if (wdl != Known[i].wdl) {
+      errors++;
+      printf("info string Mismatch wdl %d expected %d %s\n", wdl,
+             Known[i].wdl, Known[i].fen);
+    }
+  }
+
+  printf("info string tbcheck known positions %d missing %d wdl errors %d\n",
+         checked, missing, errors);
+  fflush(stdout);
+}
+
+// TB_check() runs the checks on random positions with the material given
+// like "KRvK", with white as the first side. The tables of all positions
+// that are reached by captures and promotions must be present. The index
+// computation alone is checked by "tbcheck index <material> [positions]",
+// the known positions by "tbcheck known".
+
+void TB_check(Position *pos, char *str)
+{
+  char *token = strtok(str, " \t");
+  bool index = token && strcmp(token, "index") == 0;
+  if (index)
+    token = strtok(NULL, " \t");
+  char *count = strtok(NULL, " \t");
+  bool all = index && count && strcmp(count, "all") == 0;
+  int num = all ? 0 : count ? atoi(count) : 1000, numPieces = 0;
+  char pcs[TBPIECES];
+  bool black = false;
+
+  if (token && strcmp(token, "known") == 0) {
+    tb_check_known(pos);
+    goto done;
+  }
+
+  for (char *s = token; s && *s; s++)
+    if (*s == 'v' || *s == 'V')
+      black = true;
+    else if (numPieces < TBPIECES && strchr("KQRBNP", toupper(*s)))
+      pcs[numPieces++] = black ? tolower(*s) : toupper(*s);
+
+  if (!black || (num <= 0 && !all)) {
+    printf("info string Usage: tbcheck [index] <material, like KRvK>"
+           " [positions|all] or tbcheck known\n");
+    fflush(stdout);
+    return;
+  }
+
+  if (index) {
+    tb_check_index(pos, token, pcs, numPieces, num);
+    goto done;
+  }
+
+  PRNG rng;
+  prng_init(&rng, 1070372);
+  int checked = 0, missing = 0, wdlErrors = 0, dtzErrors = 0, symErrors = 0;
+
+  for (int tries = 0; checked < num && tries < 100 * num; tries++) {
+    char board[64], flipped[64], mirrored[64];
+    Color c = tb_check_board(&rng, pcs, numPieces, board);
+
+    for (int s = 0; s < 64; s++) {
+      char p = board[s];
+      flipped[s ^ 56] = isupper(p) ? tolower(p) : toupper(p);
+      mirrored[s ^ 7] = p;
+    }
+
+    int wdl, dtz, wdl2, dtz2, wdl3, dtz3;
+    bool wdlOk, dtzOk;
+    if (!tb_check_setup(pos, board, c))
+      continue;
+    if (   !tb_check_probe(pos, &wdl, &dtz)
+        || !tb_check_moves(pos, wdl, dtz, &wdlOk, &dtzOk))
+    {
+      missing++;
+      continue;
+    }
+
+    bool symOk =   tb_check_setup(pos, flipped, !c)
+                && tb_check_probe(pos, &wdl2, &dtz2)
+                && tb_check_setup(pos, mirrored, c)
+                && tb_check_probe(pos, &wdl3, &dtz3)
+                && wdl2 == wdl && dtz2 == dtz && wdl3 == wdl && dtz3 == dtz;
+
+    checked++;
+    wdlErrors += !wdlOk;
+    dtzErrors += !dtzOk;
+    symErrors += !symOk;
+
+    if (!wdlOk || !dtzOk || !symOk) {
+      char cmd[128];
+      board_to_fen(board, c, cmd);
+      printf("info string Mismatch wdl %d dtz %d %s\n", wdl, dtz, cmd + 4);
+    }
+  }
+
+  printf("info string tbcheck %s positions %d missing %d wdl errors %d"
+         " dtz errors %d symmetry errors %d\n", token, checked, missing,
+         wdlErrors, dtzErrors, symErrors);
+  fflush(stdout);
+
+done:;
+  char startpos[] = "startpos";
+  position(pos, startpos);
+}
+
+static void init_indices(void)
+{
+  // MapB1H1H7[] encodes a square below the a1-h8 diagonal to 0...27
+  int code = 0;
+  for (Square s = 0; s < 64; s++)
+    if (off_A1H8(s) < 0)
+      MapB1H1H7[s] = code++;
+
+  // MapA1D1D4[] encodes a square in the a1-d1-d4 triangle to 0...9, the
+  // squares on the diagonal last
+  Square diagonal[4];
+  int numDiagonal = 0;
+  code = 0;
+  for (Square s = SQ_A1; s <= SQ_D4; s++)
+    if (off_A1H8(s) < 0 && file_of(s) <= FILE_D)
+      MapA1D1D4[s] = code++;
+    else if (!off_A1H8(s) && file_of(s) <= FILE_D)
+      diagonal[numDiagonal++] = s;
+
+  for (int i = 0; i < numDiagonal; i++)
+    MapA1D1D4[diagonal[i]] = code++;
+
+  // MapKK[] encodes the 462 legal placements of two kings with the first
+  // one in the a1-d1-d4 triangle. If the first king is on the a1-d4
+  // diagonal, the second one is not above the a1-h8 diagonal. Placements
+  // with both kings on the diagonal are encoded last.
+  struct { int idx; Square s; } bothOnDiagonal[64];
+  int numBoth = 0;
+  code = 0;
+  for (int idx = 0; idx < 10; idx++)
+    for (Square s1 = SQ_A1; s1 <= SQ_D4; s1++)
+      if (MapA1D1D4[s1] == idx && (idx || s1 == SQ_B1)) { // b1 is mapped to 0
+        for (Square s2 = 0; s2 < 64; s2++)
+          if ((PseudoAttacks[KING][s1] | sq_bb(s1)) & sq_bb(s2))
+            continue; // Illegal position
+          else if (!off_A1H8(s1) && off_A1H8(s2) > 0)
+            continue; // First on the diagonal, second above it
+          else if (!off_A1H8(s1) && !off_A1H8(s2)) {
+            bothOnDiagonal[numBoth].idx = idx;
+            bothOnDiagonal[numBoth++].s = s2;
+          }
+          else
+            MapKK[idx][s2] = code++;
+      }
+
+  for (int i = 0; i < numBoth; i++)
+    MapKK[bothOnDiagonal[i].idx][bothOnDiagonal[i].s] = code++;
+
+  // Binomial[k][n] is the number of ways to choose k of n elements
+  Binomial[0][0] = 1;
+  for (int n = 1; n < 64; n++)
+    for (int k = 0; k < 6 && k <= n; k++)
+      Binomial[k][n] =  (k > 0 ? Binomial[k - 1][n - 1] : 0)
+                      + (k < n ? Binomial[k    ][n - 1] : 0);
+
+  // MapPawns[s] encodes the squares a2-h7 to 0...47. It is the number of
+  // squares available to the other pawns when the leading pawn is on s.
+  // The pawn with the highest MapPawns[] leads, i.e. the one nearest to
+  // the edge and, on the same file, the one with the lowest rank.
+  int availableSquares = 47; // 63 - 16, for the leading pawn on a2
+
+  // The leading pawns are encoded per file of the first one. With 7-man
+  // tables there are up to 5 leading pawns (KPPPPPK).
+  for (int leadPawnsCnt = 1; leadPawnsCnt <= 5; leadPawnsCnt++)
+    for (int f = FILE_A; f <= FILE_D; f++) {
+      uint64_t idx = 0;
+
+      // Sum all combinations for the file, starting with the leading pawn
+      // on rank 2
+      for (int r = RANK_2; r <= RANK_7; r++) {
+        Square sq = make_square(f, r);
+
+        if (leadPawnsCnt == 1) {
+          MapPawns[sq] = availableSquares--;
+          MapPawns[sq ^ 7] = availableSquares--;
+        }
+        LeadPawnIdx[leadPawnsCnt][sq] = idx;
+        idx += Binomial[leadPawnsCnt - 1][MapPawns[sq]];
+      }
+      LeadPawnsSize[leadPawnsCnt][f] = idx;
+    }
+}
+
+// TB_free() unmaps the tables and frees their decoding data.
+
+void TB_free(void)
+{
+  for (int i = 0; i < numTables; i++) {
+    TBTable *e = &tbTables[i];
+    if (!e->baseAddress)
+      continue;
+    for (int s = 0; s < 2; s++)
+      for (int f = 0; f < 4; f++) {
+        free(e->items[s][f].base64);
+        free(e->items[s][f].symlen);
+      }
+    unmap_file(e->baseAddress, e->mapping);
+  }
+  free(tbTables);
+  tbTables = NULL;
+  numTables = 0;
+  memset(tbHash, 0, sizeof(tbHash));
+  free(paths);
+  paths = NULL;
+  TB_MaxCardinality = 0;
+}
+
+#define TB_ADD(...) \
+  tb_add((int[]){ __VA_ARGS__ }, sizeof((int[]){ __VA_ARGS__ }) / sizeof(int))
+
+// TB_init() looks for the tables in the directories of path, separated
+// by ':' (';' on Windows). The files are only mapped when first probed.
+
+void TB_init(const char *path)
+{
+  static bool initialized = false;
+
+  if (!initialized) {
+    init_indices();
+    LOCK_INIT(tbMutex);
+    initialized = true;
+  }
+
+  TB_free();
+
+  if (!*path || strcmp(path, "<empty>") == 0)
+    return;
+
+  paths = strdup(path);
+  maxTables = 2 * (TBHashSize / 2 - 1);
+  tbTables = malloc(maxTables * sizeof(TBTable));
+
+  for (int p1 = PAWN; p1 < KING; p1++) {
+    TB_ADD(KING, p1, KING);
+
+    for (int p2 = PAWN; p2 <= p1; p2++) {
+      TB_ADD(KING, p1, p2, KING);
+      TB_ADD(KING, p1, KING, p2);
+
+      for (int p3 = PAWN; p3 < KING; p3++)
+        TB_ADD(KING, p1, p2, KING, p3);
+
+      for (int p3 = PAWN; p3 <= p2; p3++) {
+        TB_ADD(KING, p1, p2, p3, KING);
+
+        for (int p4 = PAWN; p4 <= p3; p4++) {
+          TB_ADD(KING, p1, p2, p3, p4, KING);
+
+          for (int p5 = PAWN; p5 <= p4; p5++)
+            TB_ADD(KING, p1, p2, p3, p4, p5, KING);
+
+          for (int p5 = PAWN; p5 < KING; p5++)
+            TB_ADD(KING, p1, p2, p3, p4, KING, p5);
+        }
+
+        for (int p4 = PAWN; p4 < KING; p4++) {
+          TB_ADD(KING, p1, p2, p3, KING, p4);
+
+          for (int p5 = PAWN; p5 <= p4; p5++)
+            TB_ADD(KING, p1, p2, p3, KING, p4, p5);
+        }
+      }
+
+      for (int p3 = PAWN; p3 <= p1; p3++)
+        for (int p4 = PAWN; p4 <= (p1 == p3 ? p2 : p3); p4++)
+          TB_ADD(KING, p1, p2, KING, p3, p4);
+    }
+  }
+
+  printf("info string Found %d tablebases.\n", numTables / 2);
+  fflush(stdout);
+}
@@ -0,0 +1,26 @@
+#ifndef TBPROBE_H
+#define TBPROBE_H
+
+#include "search.h"
+#include "types.h"
+
+// WDL values as stored in the tables. A cursed win is a win that is a draw
+// under the 50-move rule, a blessed loss is the converse.
+enum {
+  WDL_LOSS = -2, WDL_BLESSED_LOSS = -1, WDL_DRAW = 0, WDL_CURSED_WIN = 1,
+  WDL_WIN = 2
+};
+
+extern int TB_MaxCardinality;
+extern int TB_Cardinality;
+extern bool TB_RootInTB, TB_UseRule50;
+extern Depth TB_ProbeDepth;
+
+void TB_init(const char *path);
+void TB_free(void);
+int TB_probe_wdl(Position *pos, int *success);
+int TB_probe_dtz(Position *pos, int *success);
+void TB_rank_root_moves(Position *pos, RootMoves *rm);
+void TB_check(Position *pos, char *str);
+
+#endif
@@ -46,9 +46,7 @@ int numCmhTables = 0;
 CounterMoveStat counterMoves __attribute__((aligned(64))) = { 0 };
 ButterflyHistory mainHistory __attribute__((aligned(64))) = { 0 };
 CapturePieceToHistory captureHistory __attribute__((aligned(64))) = { 0 };
-PawnCorrectionHistory pawnCorrectionHistory __attribute__((aligned(64))) = { 0 };
-MinorPieceCorrectionHistory minorPieceCorrectionHistory __attribute__((aligned(64))) = { 0 };
-NonPawnCorrectionHistory nonPawnCorrectionHistory __attribute__((aligned(64))) = { 0 };
+CorrectionHistory correctionHistory __attribute__((aligned(64))) = { 0 };
 PawnTable pawnTable __attribute__((aligned(64))) = { 0 };
 MaterialTable materialTable __attribute__((aligned(64))) = { 0 };
 CounterMoveHistoryStat cmhTable __attribute__((aligned(64))) = { 0 };
@@ -68,23 +66,32 @@ static THREAD_FUNC thread_init(void *arg)
 {
   int idx = (intptr_t)arg;
 
-  int node;
-  node = 0;
-#ifdef PER_THREAD_CMH
-  (void)node;
-#else
-  int t = node;
-#endif
+  int node = 0;
+  if (settings.numaEnabled)
+    node = bind_thread_to_numa_node(idx);
   cmh_init();
 
   Position *pos;
 
-  pos = calloc(sizeof(Position), 1);
-  pos->rootMoves = calloc(sizeof(RootMoves), 1);
-  pos->stackAllocation = calloc(63 + (MAX_PLY + 110) * sizeof(Stack), 1);
-  pos->moveList = calloc(10000 * sizeof(ExtMove), 1);
-  pos->stack = (Stack *)(((uintptr_t)pos->stackAllocation + 0x3f) & ~0x3f);
+  // Once bound, the per-thread data is allocated on the thread's own node
+  if (settings.numaEnabled) {
+    pos = numa_alloc(sizeof(Position));
+    pos->rootMoves = numa_alloc(sizeof(RootMoves));
+    pos->stackAllocation = numa_alloc(stacks_size(MAX_PLY + 110));
+    pos->moveList = numa_alloc(10000 * sizeof(ExtMove));
+    pos->pvTable = numa_alloc(PV_TABLE_SIZE * sizeof(Move));
+    pos->searched = numa_alloc((MAX_PLY + 1) * sizeof(SearchedMoves));
+  } else {
+    pos = calloc(sizeof(Position), 1);
+    pos->rootMoves = calloc(sizeof(RootMoves), 1);
+    pos->stackAllocation = calloc(stacks_size(MAX_PLY + 110), 1);
+    pos->moveList = calloc(10000 * sizeof(ExtMove), 1);
+    pos->pvTable = calloc(PV_TABLE_SIZE * sizeof(Move), 1);
+    pos->searched = calloc((MAX_PLY + 1) * sizeof(SearchedMoves), 1);
+  }
+  pos_init_stacks(pos, MAX_PLY + 110);
   pos->threadIdx = idx;
+  pos->numaNode = node;
 
   atomic_store(&pos->resetCalls, false);
   pos->selDepth = pos->callsCnt = 0;
@@ -93,6 +100,8 @@ static THREAD_FUNC thread_init(void *arg)
 
   pthread_mutex_init(&pos->mutex, NULL);
   pthread_cond_init(&pos->sleepCondition, NULL);
+  atomic_store(&pos->parked, false);
+  atomic_store(&pos->waiting, 0);
 
   Threads.pos[idx] = pos;
 
@@ -149,10 +158,7 @@ static void thread_create(int idx)
 static void thread_destroy(Position *pos)
 {
 #ifndef _WIN32
-  pthread_mutex_lock(&pos->mutex);
-  pos->action = THREAD_EXIT;
-  pthread_cond_signal(&pos->sleepCondition);
-  pthread_mutex_unlock(&pos->mutex);
+  thread_wake_up(pos, THREAD_EXIT);
   pthread_join(pos->nativeThread, NULL);
   pthread_cond_destroy(&pos->sleepCondition);
   pthread_mutex_destroy(&pos->mutex);
@@ -166,18 +172,54 @@ static void thread_destroy(Position *pos)
 
   if (settings.numaEnabled) {
     numa_free(pos->rootMoves, sizeof(RootMoves));
-    numa_free(pos->stackAllocation, 63 + (MAX_PLY + 110) * sizeof(Stack));
+    numa_free(pos->stackAllocation, stacks_size(MAX_PLY + 110));
     numa_free(pos->moveList, 10000 * sizeof(ExtMove));
+    numa_free(pos->pvTable, PV_TABLE_SIZE * sizeof(Move));
+    numa_free(pos->searched, (MAX_PLY + 1) * sizeof(SearchedMoves));
     numa_free(pos, sizeof(Position));
   } else {
     free(pos->rootMoves);
     free(pos->stackAllocation);
     free(pos->moveList);
+    free(pos->pvTable);
+    free(pos->searched);
     free(pos);
   }
 }
 
 
+#ifndef _WIN32
+
+// Spinning only pays off when the thread that ends the wait can run on
+// another CPU at the same time.
+static bool spinAllowed;
+
+// spin_until() busy-waits for at most the "Spin Wait" time until the action
+// of the thread does (or, with sleeping false, does not) equal THREAD_SLEEP.
+// Waking a thread that spins costs no system call and no scheduler latency,
+// so short gaps between searches are bridged without parking the thread.
+
+static bool spin_until(Position *pos, bool sleeping)
+{
+  TimePoint limit = option_value(OPT_SPIN_WAIT);
+
+  if (!limit || !spinAllowed)
+    return false;
+
+  TimePoint start = now();
+  for (int i = 1; ; i++) {
+    if ((atomic_load(&pos->action) == THREAD_SLEEP) == sleeping)
+      return true;
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+    if (!(i & 63) && now() - start > limit)
+      return false;
+  }
+}
+
+#endif
+
 // thread_wait_for_search_finished() waits on sleep condition until
 // not searching.
 
@@ -185,12 +227,16 @@ void thread_wait_until_sleeping(Position *pos)
 {
 #ifndef _WIN32
 
-  pthread_mutex_lock(&pos->mutex);
+  if (!spin_until(pos, true)) {
+    pthread_mutex_lock(&pos->mutex);
+    atomic_fetch_add(&pos->waiting, 1);
 
-  while (pos->action != THREAD_SLEEP)
-    pthread_cond_wait(&pos->sleepCondition, &pos->mutex);
+    while (atomic_load(&pos->action) != THREAD_SLEEP)
+      pthread_cond_wait(&pos->sleepCondition, &pos->mutex);
 
-  pthread_mutex_unlock(&pos->mutex);
+    atomic_fetch_sub(&pos->waiting, 1);
+    pthread_mutex_unlock(&pos->mutex);
+  }
 
 #else
 
@@ -225,24 +271,31 @@ void thread_wait(Position *pos, atomic_bool *condition)
 }
 
 
+// thread_wake_up() hands an action to the thread. The action word is
+// written first, so that a spinning thread picks it up on its own, and the
+// condition variable is only signalled when the thread has parked. Both
+// sides use sequentially consistent accesses: either the thread sees the
+// action before parking or we see it parked.
+
 void thread_wake_up(Position *pos, int action)
 {
 #ifndef _WIN32
 
+  if (action != THREAD_RESUME) {
+    atomic_store(&pos->action, action);
+    if (!atomic_load(&pos->parked))
+      return;
+  }
+
   pthread_mutex_lock(&pos->mutex);
+  pthread_cond_broadcast(&pos->sleepCondition);
+  pthread_mutex_unlock(&pos->mutex);
 
-#endif
+#else
 
   if (action != THREAD_RESUME)
     pos->action = action;
 
-#ifndef _WIN32
-
-  pthread_cond_signal(&pos->sleepCondition);
-  pthread_mutex_unlock(&pos->mutex);
-
-#else
-
   SetEvent(pos->startEvent);
 
 #endif
@@ -256,14 +309,16 @@ static void thread_idle_loop(Position *pos)
   while (true) {
 #ifndef _WIN32
 
-    pthread_mutex_lock(&pos->mutex);
+    if (!spin_until(pos, false)) {
+      pthread_mutex_lock(&pos->mutex);
+      atomic_store(&pos->parked, true);
 
-    while (pos->action == THREAD_SLEEP) {
-      pthread_cond_signal(&pos->sleepCondition); // Wake up any waiting thread
-      pthread_cond_wait(&pos->sleepCondition, &pos->mutex);
-    }
+      while (atomic_load(&pos->action) == THREAD_SLEEP)
+        pthread_cond_wait(&pos->sleepCondition, &pos->mutex);
 
-    pthread_mutex_unlock(&pos->mutex);
+      atomic_store(&pos->parked, false);
+      pthread_mutex_unlock(&pos->mutex);
+    }
 
 #else
 
@@ -288,9 +343,18 @@ static void thread_idle_loop(Position *pos)
 
     }
 
-    pos->action = THREAD_SLEEP;
+    atomic_store(&pos->action, THREAD_SLEEP);
+
+#ifndef _WIN32
+
+    // Wake up any thread blocked in thread_wait_until_sleeping()
+    if (atomic_load(&pos->waiting)) {
+      pthread_mutex_lock(&pos->mutex);
+      pthread_cond_broadcast(&pos->sleepCondition);
+      pthread_mutex_unlock(&pos->mutex);
+    }
 
-#ifdef _WIN32
+#else
 
     SetEvent(pos->stopEvent);
 
@@ -310,6 +374,7 @@ void threads_init(void)
 
   pthread_mutex_init(&Threads.mutex, NULL);
   pthread_cond_init(&Threads.sleepCondition, NULL);
+  spinAllowed = sysconf(_SC_NPROCESSORS_ONLN) > 1;
 
 #else
 
@@ -360,8 +425,10 @@ void threads_exit(void)
 
 void threads_set_number(int num)
 {
-  // while (Threads.numThreads < num)
-  //   thread_create(Threads.numThreads++);
+  num = min(num, MAX_THREADS);
+
+  while (Threads.numThreads < num)
+    thread_create(Threads.numThreads++);
 
   while (Threads.numThreads > num)
     thread_destroy(Threads.pos[--Threads.numThreads]);
@@ -382,3 +449,13 @@ uint64_t threads_nodes_searched(void)
     nodes += Threads.pos[idx]->nodes;
   return nodes;
 }
+
+// threads_tb_hits() returns the number of TB hits.
+
+uint64_t threads_tb_hits(void)
+{
+  uint64_t hits = 0;
+  for (int idx = 0; idx < Threads.numThreads; idx++)
+    hits += Threads.pos[idx]->tbHits;
+  return hits;
+}
@@ -28,6 +28,7 @@
 #include <windows.h>
 #endif
 
+#include "misc.h"
 #include "types.h"
 
 #define MAX_THREADS 1
@@ -66,6 +67,15 @@ struct MainThread {
   double previousTimeReduction;
   Value previousScore;
   Value iterValue[4];
+  // The rest of the previous best line after the reply we expected
+  Key reuseKey;
+  Depth reuseDepth;
+  int reusePvSize;
+  Move reusePv[MAX_PLY];
+  // Time and nodes at which the current solution became the best move
+  int solveIters;
+  TimePoint solveTime;
+  uint64_t solveNodes;
 };
 
 typedef struct MainThread MainThread;
@@ -101,6 +111,7 @@ void threads_exit(void);
 void threads_start_thinking(Position *pos, LimitsType *);
 void threads_set_number(int num);
 uint64_t threads_nodes_searched(void);
+uint64_t threads_tb_hits(void);
 
 extern ThreadPool Threads;
 
@@ -115,8 +126,24 @@ extern int numCmhTables;
 extern CounterMoveStat counterMoves;
 extern ButterflyHistory mainHistory;
 extern CapturePieceToHistory captureHistory;
-extern PawnCorrectionHistory pawnCorrectionHistory;
-extern MinorPieceCorrectionHistory minorPieceCorrectionHistory;
-extern NonPawnCorrectionHistory nonPawnCorrectionHistory;
+extern CorrectionHistory correctionHistory;
+
+// pawn_corr(), minor_corr() and non_pawn_corr() return the pair of
+// correction history entries selected by a key.
+
+INLINE int16_t *pawn_corr(Key key)
+{
+  return correctionHistory.pawn[key & (PAWN_CORRECTION_HISTORY_SIZE - 1)];
+}
+
+INLINE int16_t *minor_corr(Key key)
+{
+  return correctionHistory.minorPiece[key & (MINOR_CORRECTION_HISTORY_SIZE - 1)];
+}
+
+INLINE int16_t *non_pawn_corr(Color c, Key key)
+{
+  return correctionHistory.nonPawn[c][key & (NON_PAWN_CORRECTION_HISTORY_SIZE - 1)];
+}
 
 #endif
@@ -27,14 +27,69 @@
 
 struct TimeManagement Time; // Our global time management struct
 
+// Latencies of the last moves: from 'go' to the start of the search and
+// from the stop signal to 'bestmove'.
+#define LATENCY_SAMPLES 64
+
+static TimePoint startLatencies[LATENCY_SAMPLES];
+static TimePoint stopLatencies[LATENCY_SAMPLES];
+static int latencyCnt;
+
+// time_record_latency() is called once 'bestmove' has been sent for a
+// time-managed search.
+
+void time_record_latency(TimePoint startLatency, TimePoint stopLatency)
+{
+  int i = latencyCnt++ % LATENCY_SAMPLES;
+  startLatencies[i] = startLatency;
+  stopLatencies[i] = stopLatency;
+}
+
+// time_latency() returns the given percentile of the recorded start or
+// stop latencies, or -1 if no move has been recorded yet.
+
+TimePoint time_latency(bool stop, int percent)
+{
+  const TimePoint *samples = stop ? stopLatencies : startLatencies;
+  int n = min(latencyCnt, LATENCY_SAMPLES);
+  TimePoint v[LATENCY_SAMPLES];
+
+  if (n == 0)
+    return -1;
+
+  for (int i = 0; i < n; i++) {
+    int j = i;
+    for (; j > 0 && v[j - 1] > samples[i]; j--)
+      v[j] = v[j - 1];
+    v[j] = samples[i];
+  }
+
+  return v[(n - 1) * percent / 100];
+}
+
+// time_move_overhead() returns the time to reserve for each move. In the
+// automatic mode this is the 95th percentile of the measured stop latency,
+// which includes the polling delay of check_time(), plus 1 ms for passing
+// 'bestmove' to the GUI, which we cannot measure. The start latency is not
+// added because it already counts towards the elapsed time.
+
+TimePoint time_move_overhead(void)
+{
+  if (option_value(OPT_AUTO_OVERHEAD) && latencyCnt >= 8)
+    return time_latency(true, 95) + 1000;
+
+  return 1000 * (TimePoint)option_value(OPT_MOVE_OVERHEAD);
+}
+
 // tm_init() is called at the beginning of the search and calculates the
 // time bounds allowed for the current game ply. We currently support:
 // 1) x basetime (+z increment)
 // 2) x moves in y seconds (+z increment)
+// The UCI limits are given in milliseconds, the bounds are in microseconds.
 
 void time_init(Color us, int ply)
 {
-  int moveOverhead    = option_value(OPT_MOVE_OVERHEAD);
+  TimePoint moveOverhead = time_move_overhead();
   int slowMover       = option_value(OPT_SLOW_MOVER);
   int npmsec          = option_value(OPT_NODES_TIME);
 
@@ -57,6 +112,8 @@ void time_init(Color us, int ply)
   }
 
   Time.startTime = Limits.startTime;
+  TimePoint time = 1000 * (TimePoint)Limits.time[us];
+  TimePoint inc  = 1000 * (TimePoint)Limits.inc[us];
 
   // Maximum move horizon of 50 moves
   int mtg = Limits.movestogo ? min(Limits.movestogo, 50) : 50;
@@ -68,7 +125,7 @@ void time_init(Color us, int ply)
     }
 
   // Make sure that timeLeft > 0 since we may use it as a divisor
-  TimePoint timeLeft = max(1, Limits.time[us] + Limits.inc[us] * (mtg - 1) - moveOverhead * (2 + mtg));
+  TimePoint timeLeft = max((TimePoint)1, time + inc * (mtg - 1) - moveOverhead * (2 + mtg));
 
   double optExtra = clamp(1.0 + 12.0 * Limits.inc[us] / Limits.time[us], 1.0, 1.12);
 
@@ -81,23 +138,23 @@ void time_init(Color us, int ply)
   // game time for the current move, so also cap to 20% of available game time.
   if (Limits.movestogo == 0) {
     optScale = min(0.0084 + pow(ply + 3.0, 0.5) * 0.0042,
-                    0.2 * Limits.time[us] / (double)timeLeft)
+                    0.2 * time / (double)timeLeft)
               * optExtra;
     maxScale = min(7.0, 4.0 + ply / 12.0);
   }
   // x moves in y seconds (+z increment)
   else {
     optScale = min((0.88 + ply / 116.4) / mtg,
-                     0.88 * Limits.time[us] / (double)timeLeft);
+                     0.88 * time / (double)timeLeft);
     maxScale = min(6.3, 1.5 + 0.11 * mtg);
   }
 
   // Never use more than 80% of the available time for this move
   Time.optimumTime = optScale * timeLeft;
-  Time.maximumTime = min(0.8 * Limits.time[us] - moveOverhead, maxScale * Time.optimumTime);
+  Time.maximumTime = min(0.8 * time - moveOverhead, maxScale * Time.optimumTime);
 
   if (use_time_management()) {
-    int strength = log(max(1, (int)(Time.optimumTime * Threads.numThreads  / 10))) * 60;
+    int strength = log(max(1, (int)(Time.optimumTime * Threads.numThreads  / 10000))) * 60;
     Time.tempoNNUE = clamp((strength + 264) / 24, 18, 30);
   } else
     Time.tempoNNUE = 28; // default for no time given
@@ -30,8 +30,9 @@
 
 struct TimeManagement {
   TimePoint startTime;
-  int optimumTime;
-  int maximumTime;
+  _Atomic TimePoint stopTime;
+  TimePoint optimumTime;
+  TimePoint maximumTime;
   int64_t availableNodes;
   int tempoNNUE;
 };
@@ -39,6 +40,9 @@ struct TimeManagement {
 extern struct TimeManagement Time;
 
 void time_init(Color us, int ply);
+void time_record_latency(TimePoint startLatency, TimePoint stopLatency);
+TimePoint time_latency(bool stop, int percent);
+TimePoint time_move_overhead(void);
 
 #define time_optimum() Time.optimumTime
 #define time_maximum() Time.maximumTime
@@ -48,4 +52,15 @@ INLINE TimePoint time_elapsed(void)
   return now() - Time.startTime;
 }
 
+// time_mark_stop() records when the search was told to stop. Only the first
+// call counts, so that a limit crossed between two checks is stamped with
+// the limit itself and the polling delay shows up in the stop latency. The
+// UCI thread and the search thread may race here, hence the exchange.
+
+INLINE void time_mark_stop(TimePoint t)
+{
+  TimePoint unset = 0;
+  atomic_compare_exchange_strong(&Time.stopTime, &unset, t);
+}
+
 #endif
@@ -35,13 +35,68 @@
 
 TranspositionTable TT; // Our global transposition table
 
+static const char TTMagic[8] = { 'C', 'f', 'i', 's', 'h', 'T', 'T', '1' };
+
 // tt_free() frees the allocated transposition table memory.
 
 void tt_free(void)
 {
-  if (TT.table)
+  if (TT.header)
+    unmap_file(TT.header, TT.map);
+  else if (TT.table)
     free_memory(&TT.alloc);
   TT.table = NULL;
+  TT.header = NULL;
+}
+
+
+// tt_map() backs the table by a file, which keeps its contents across
+// restarts. It returns NULL if the file cannot be used. warm is set if
+// the file already holds a table of the current size, which is then used
+// as it is.
+
+static Cluster *tt_map(const char *file, size_t size, bool *warm)
+{
+  map_t map;
+  FD fd = open_file(file);
+
+  *warm = false;
+  if (fd != FD_ERR) {
+    // Never overwrite a file that holds something else than a table
+    size_t fileSize = file_size(fd);
+    const TTFileHeader *h = fileSize >= TTHeaderSize ? map_file(fd, &map) : NULL;
+    bool isTable = h && memcmp(h->magic, TTMagic, sizeof(TTMagic)) == 0;
+    *warm =   isTable
+           && h->clusterSize == sizeof(Cluster)
+           && h->clusterCount == TT.clusterCount
+           && fileSize == TTHeaderSize + size;
+    unmap_file(h, map);
+    close_file(fd);
+    if (fileSize && !isTable) {
+      fprintf(stderr, "File %s is not a transposition table.\n", file);
+      return NULL;
+    }
+  }
+
+  fd = open_file_rw(file);
+  if (fd == FD_ERR)
+    return NULL;
+  void *data = map_file_rw(fd, TTHeaderSize + size, &TT.map);
+  close_file(fd);
+  if (!data)
+    return NULL;
+
+  TT.header = data;
+  if (*warm)
+    TT.generation8 = TT.header->generation8;
+  else {
+    memcpy(TT.header->magic, TTMagic, sizeof(TTMagic));
+    TT.header->clusterCount = TT.clusterCount;
+    TT.header->clusterSize = sizeof(Cluster);
+    TT.header->generation8 = TT.generation8;
+  }
+
+  return (Cluster *)((char *)data + TTHeaderSize);
 }
 
 
@@ -52,12 +107,26 @@ void tt_allocate(size_t kbSize)
   TT.clusterCount = kbSize * 1024 / sizeof(Cluster);
   size_t size = TT.clusterCount * sizeof(Cluster);
 
+  bool warm = false;
   TT.table = NULL;
+  if (settings.ttFile[0] && !(TT.table = tt_map(settings.ttFile, size, &warm)))
+    fprintf(stderr, "Unable to map %s, using memory.\n", settings.ttFile);
   if (!TT.table)
     TT.table = allocate_memory(size, false, &TT.alloc);
   if (!TT.table)
     goto failed;
 
+  // Spread the table over the selected nodes before it is first touched
+  if (settings.numaEnabled)
+    numa_interleave_memory(TT.table, size, settings.mask);
+
+  // A table from a previous session is kept
+  if (warm) {
+    printf("info string Resuming with the table in %s.\n", settings.ttFile);
+    fflush(stdout);
+    return;
+  }
+
   // Clear the TT table to page in the memory immediately. This avoids
   // an initial slow down during the first second or minutes of the search.
   tt_clear();
@@ -102,6 +171,89 @@ void tt_clear_worker(int idx)
 }
 
 
+// tt_save() writes the transposition table to a file, preceded by a header
+// with its size and generation.
+
+void tt_save(const char *file)
+{
+  process_delayed_settings();
+
+  if (TT.header && strcmp(file, settings.ttFile) == 0) {
+    printf("info string The table is already backed by %s.\n", file);
+    fflush(stdout);
+    return;
+  }
+
+  FILE *F = fopen(file, "wb");
+  if (!F) {
+    fprintf(stderr, "Unable to open file %s\n", file);
+    return;
+  }
+
+  char header[TTHeaderSize] = { 0 };
+  TTFileHeader *h = (TTFileHeader *)header;
+  memcpy(h->magic, TTMagic, sizeof(TTMagic));
+  h->clusterCount = TT.clusterCount;
+  h->clusterSize = sizeof(Cluster);
+  h->generation8 = TT.generation8;
+
+  bool ok =   fwrite(header, TTHeaderSize, 1, F) == 1
+           && fwrite(TT.table, sizeof(Cluster), TT.clusterCount, F) == TT.clusterCount;
+  if (fclose(F) || !ok) {
+    fprintf(stderr, "Unable to write file %s\n", file);
+    return;
+  }
+  printf("info string Saved the table to %s.\n", file);
+  fflush(stdout);
+}
+
+// tt_load() reads a table written by tt_save() or backed by a file. It
+// must have been saved with the current Hash size, as the entries cannot
+// be redistributed over a different number of clusters.
+
+void tt_load(const char *file)
+{
+  process_delayed_settings();
+
+  if (TT.header && strcmp(file, settings.ttFile) == 0) {
+    printf("info string The table is already backed by %s.\n", file);
+    fflush(stdout);
+    return;
+  }
+
+  FD fd = open_file(file);
+  if (fd == FD_ERR) {
+    fprintf(stderr, "Unable to open file %s\n", file);
+    return;
+  }
+
+  map_t map;
+  size_t fileSize = file_size(fd);
+  const TTFileHeader *h = fileSize >= TTHeaderSize ? map_file(fd, &map) : NULL;
+  close_file(fd);
+
+  if (   !h
+      || memcmp(h->magic, TTMagic, sizeof(TTMagic)) != 0
+      || h->clusterSize != sizeof(Cluster)
+      || fileSize != TTHeaderSize + h->clusterCount * sizeof(Cluster))
+    fprintf(stderr, "File %s is not a transposition table.\n", file);
+  else if (h->clusterCount != TT.clusterCount)
+    fprintf(stderr, "The table in %s needs Hash %" PRIu64 ".\n", file,
+            (uint64_t)(h->clusterCount * sizeof(Cluster) / 1024));
+  else {
+    memcpy(TT.table, (const char *)h + TTHeaderSize,
+           TT.clusterCount * sizeof(Cluster));
+    TT.generation8 = h->generation8;
+    if (TT.header)
+      TT.header->generation8 = TT.generation8;
+    printf("info string Loaded the table from %s.\n", file);
+    fflush(stdout);
+  }
+
+  unmap_file(h, map);
+}
+
+
 // tt_probe() looks up the current position in the transposition table.
 // It returns true and a pointer to the TTEntry if the position is found.
 // Otherwise, it returns false and a pointer to an empty or least valuable
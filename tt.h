@@ -62,10 +62,27 @@ struct Cluster {
 
 typedef struct Cluster Cluster;
 
+// A saved or file backed table starts with a header that identifies it.
+// The header is padded to TTHeaderSize, which keeps the clusters that
+// follow it aligned.
+
+enum { TTHeaderSize = 4096 };
+
+struct TTFileHeader {
+  char magic[8];
+  uint64_t clusterCount;
+  uint32_t clusterSize;
+  uint8_t generation8;
+};
+
+typedef struct TTFileHeader TTFileHeader;
+
 struct TranspositionTable {
   size_t clusterCount;
   Cluster *table;
   alloc_t alloc;
+  TTFileHeader *header; // Set if the table is backed by a file
+  map_t map;
   uint8_t generation8; // Size must be not bigger than TTEntry::genBound8
 };
 
@@ -130,6 +147,8 @@ void tt_free(void);
 INLINE void tt_new_search(void)
 {
   TT.generation8 += 8; // Lower 3 bits are used by PvNode and Bound
+  if (TT.header)
+    TT.header->generation8 = TT.generation8;
 }
 
 INLINE TTEntry *tt_first_entry(Key key)
@@ -142,5 +161,7 @@ int tt_hashfull(void);
 void tt_allocate(size_t kbSize);
 void tt_clear(void);
 void tt_clear_worker(int idx);
+void tt_save(const char *file);
+void tt_load(const char *file);
 
 #endif
@@ -333,9 +333,14 @@ typedef int16_t CapturePieceToHistory[16][64][8];
 #define NON_PAWN_CORRECTION_HISTORY_SIZE 8192
 #define CORRECTION_HISTORY_LIMIT 1024
 
-typedef int16_t PawnCorrectionHistory[PAWN_CORRECTION_HISTORY_SIZE][2];
-typedef int16_t MinorPieceCorrectionHistory[MINOR_CORRECTION_HISTORY_SIZE][2];
-typedef int16_t NonPawnCorrectionHistory[2][NON_PAWN_CORRECTION_HISTORY_SIZE][2];
+// The correction histories are kept together in one block. Each key
+// selects a pair of entries, one per side to move, so a lookup touches a
+// single cache line per table.
+typedef struct {
+  int16_t pawn[PAWN_CORRECTION_HISTORY_SIZE][2];
+  int16_t minorPiece[MINOR_CORRECTION_HISTORY_SIZE][2];
+  int16_t nonPawn[2][NON_PAWN_CORRECTION_HISTORY_SIZE][2];
+} CorrectionHistory;
 
 struct ExtMove {
   Move move;
@@ -344,6 +349,22 @@ struct ExtMove {
 
 typedef struct ExtMove ExtMove;
 
+// SearchStats counts how often the pruning, reduction and extension rules
+// of the search fire, and how often their verification or re-search shows
+// them to be wrong.
+
+struct SearchStats {
+  uint64_t futility;
+  uint64_t nullTried, nullCut, nullVerified, nullVerifyFail;
+  uint64_t probCutTried, probCutQsHeld, probCutCut;
+  uint64_t singularTried, singularExt, multiCut;
+  uint64_t lmrTried, lmrReSearch, lmrReSearchFail, lmrDeeper;
+  uint64_t pvReSearch;
+  uint64_t effortStop, effortExtend;
+};
+
+typedef struct SearchStats SearchStats;
+
 struct PSQT {
   Score psq[16][64];
 };
@@ -16,18 +16,24 @@
   along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <inttypes.h>
 #include <stdio.h>
 #include <string.h>
 #include <ctype.h>
 
+#include "analyze.h"
+#include "benchmark.h"
 #include "evaluate.h"
 #include "misc.h"
 #include "movegen.h"
+#include "movepick.h"
 #include "position.h"
 #include "search.h"
 #include "settings.h"
+#include "tbprobe.h"
 #include "thread.h"
 #include "timeman.h"
+#include "tt.h"
 #include "uci.h"
 
 // FEN string of the initial position, normal chess
@@ -92,7 +98,7 @@ void position(Position *pos, char *str)
   }
 
   pos->rootKeyFlip = pos->st->key;
-  (pos->st-1)->endMoves = pos->moveList;
+  picker(pos->st-1)->endMoves = pos->moveList;
 
   // Clear history position keys that have not yet repeated. This ensures
   // that is_draw() does not flag as a draw the first repetition of a
@@ -194,9 +200,13 @@ static void go(Position *pos, char *str)
     else if (strcmp(token, "ponder") == 0)
       ponderMode = true;
     else if (strcmp(token, "perft") == 0) {
-      char str_buf[64];
-      sprintf(str_buf, "%d %d %d current perft", option_value(OPT_HASH),
-                    option_value(OPT_THREADS), atoi(strtok(NULL, " \t")));
+      Depth d = atoi(strtok(NULL, " \t"));
+      TimePoint start = now();
+      uint64_t nodes = perft(pos, d);
+      TimePoint elapsed = now() - start + 1;
+      printf("\nNodes searched: %" PRIu64 "\nNodes/second: %" PRIu64 "\n",
+             nodes, 1000000 * nodes / elapsed);
+      fflush(stdout);
       return;
     }
   }
@@ -233,16 +243,16 @@ void uci_loop(int argc, char **argv)
   // This variable must be accessed only after acquiring Threads.lock.
   Threads.sleeping = false;
 
-  // Allocate 201 Stack slots.
+  // Allocate 215 Stack slots.
   // Slots 100-200 form a circular buffer to be filled with game moves.
   // Slots 0-99 make room for prepending the part of game history relevant
   // for repetition detection.
   // Slots 201-214 may be used by TB root probing.
-  pos.stackAllocation = malloc(63 + 201 * sizeof(Stack));
-  pos.stack = (Stack *)(((uintptr_t)pos.stackAllocation + 0x3f) & ~0x3f);
+  pos.stackAllocation = malloc(stacks_size(215));
+  pos_init_stacks(&pos, 215);
   pos.moveList = malloc(1000 * sizeof(ExtMove));
   pos.st = pos.stack + 100;
-  pos.st[-1].endMoves = pos.moveList;
+  pos.mpStack[99].endMoves = pos.moveList;
 
   size_t buf_size = 1;
   for (int i = 1; i < argc; i++)
@@ -290,6 +300,7 @@ void uci_loop(int argc, char **argv)
     // but switch from pondering to normal search.
     if (strcmp(token, "quit") == 0 || strcmp(token, "stop") == 0) {
       if (Threads.searching) {
+        time_mark_stop(now());
         Threads.stop = true;
         LOCK(Threads.lock);
         if (Threads.sleeping)
@@ -300,10 +311,13 @@ void uci_loop(int argc, char **argv)
     }
     else if (strcmp(token, "ponderhit") == 0) {
       Threads.ponder = false; // Switch to normal search
-      if (Threads.stopOnPonderhit)
+      if (Threads.stopOnPonderhit) {
+        time_mark_stop(now());
         Threads.stop = true;
+      }
       LOCK(Threads.lock);
       if (Threads.sleeping) {
+        time_mark_stop(now());
         Threads.stop = true;
         thread_wake_up(threads_main(), THREAD_RESUME);
         Threads.sleeping = false;
@@ -327,6 +341,19 @@ void uci_loop(int argc, char **argv)
     else if (strcmp(token, "position") == 0)  position(&pos, str);
     else if (strcmp(token, "setoption") == 0) setoption(str);
 
+    // Additional custom non-UCI commands, useful for debugging
+    else if (strcmp(token, "bench") == 0)     benchmark(&pos, str);
+    else if (strcmp(token, "analyze") == 0)   analyze(&pos, str);
+    else if (strcmp(token, "solve") == 0)     solve(&pos, str);
+    else if (strcmp(token, "tt_save") == 0)   tt_save(str);
+    else if (strcmp(token, "tt_load") == 0)   tt_load(str);
+    else if (strcmp(token, "mpbench") == 0)
+      mp_bench(&pos, *str ? atoi(str) : 100000);
+    else if (strcmp(token, "stats") == 0)
+      print_stats();
+    else if (strcmp(token, "tbcheck") == 0)
+      TB_check(&pos, str);
+
   } while (argc == 1 && strcmp(token, "quit") != 0);
 
   if (Threads.searching)
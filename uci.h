@@ -41,10 +41,14 @@ enum {
   OPT_THREADS,
   OPT_HASH,
   OPT_CLEAR_HASH,
+  OPT_HASH_FILE,
   OPT_PONDER,
   OPT_MULTI_PV,
   OPT_SKILL_LEVEL,
   OPT_MOVE_OVERHEAD,
+  OPT_AUTO_OVERHEAD,
+  OPT_PV_REUSE_DEPTH,
+  OPT_SPIN_WAIT,
   OPT_SLOW_MOVER,
   OPT_NODES_TIME,
   OPT_ANALYSE_MODE,
@@ -53,7 +57,6 @@ enum {
   OPT_SYZ_PROBE_DEPTH,
   OPT_SYZ_50_MOVE,
   OPT_SYZ_PROBE_LIMIT,
-  OPT_SYZ_USE_DTM,
   OPT_BOOK_FILE,
   OPT_BOOK_FILE2,
   OPT_BOOK_BEST_MOVE,
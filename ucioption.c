@@ -30,9 +30,10 @@
 #include "evaluate.h"
 #include "misc.h"
 #include "numa.h"
-// #include "polybook.h"
+#include "polybook.h"
 #include "search.h"
 #include "settings.h"
+#include "tbprobe.h"
 #include "thread.h"
 #include "tt.h"
 #include "uci.h"
@@ -51,14 +52,20 @@ static void on_hash_size(Option *opt) //in MB
   delayedSettings.ttSize = opt->value;
 }
 
-// static void on_numa(Option *opt)
-// {
-// #ifdef NUMA
-//   read_numa_nodes(opt->valString);
-// #else
-//   (void)opt;
-// #endif
-// }
+static void on_hash_file(Option *opt)
+{
+  const char *file = strcmp(opt->valString, "<empty>") ? opt->valString : "";
+  snprintf(delayedSettings.ttFile, sizeof(delayedSettings.ttFile), "%s", file);
+}
+
+static void on_numa(Option *opt)
+{
+#ifdef NUMA
+  read_numa_nodes(opt->valString);
+#else
+  (void)opt;
+#endif
+}
 
 static void on_threads(Option *opt)
 {
@@ -70,25 +77,30 @@ static void on_large_pages(Option *opt)
   delayedSettings.largePages = opt->value;
 }
 
-// static void on_book_file(Option *opt)
-// {
-//   pb_init(&polybook, opt->valString);
-// }
+static void on_tb_path(Option *opt)
+{
+  TB_init(opt->valString);
+}
 
-// static void on_book_file2(Option *opt)
-// {
-//   pb_init(&polybook2, opt->valString);
-// }
+static void on_book_file(Option *opt)
+{
+  pb_init(&polybook, opt->valString);
+}
 
-// static void on_best_book_move(Option *opt)
-// {
-//   pb_set_best_book_move(opt->value);
-// }
+static void on_book_file2(Option *opt)
+{
+  pb_init(&polybook2, opt->valString);
+}
 
-// static void on_book_depth(Option *opt)
-// {
-//   pb_set_book_depth(opt->value);
-// }
+static void on_best_book_move(Option *opt)
+{
+  pb_set_best_book_move(opt->value);
+}
+
+static void on_book_depth(Option *opt)
+{
+  pb_set_book_depth(opt->value);
+}
 
 #ifdef IS_64BIT
 #define MAXHASHKB 33554432
@@ -103,14 +115,26 @@ static Option optionsMap[] = {
   { "Threads", OPT_TYPE_SPIN, 1, 1, MAX_THREADS, NULL, on_threads, 0, NULL },
   { "Hash", OPT_TYPE_SPIN, 1024, 64, MAXHASHKB, NULL, on_hash_size, 0, NULL }, //This is in kB
   { "Clear Hash", OPT_TYPE_BUTTON, 0, 0, 0, NULL, on_clear_hash, 0, NULL },
+  { "Hash File", OPT_TYPE_STRING, 0, 0, 0, "<empty>", on_hash_file, 0, NULL },
   { "Ponder", OPT_TYPE_CHECK, 0, 0, 0, NULL, NULL, 0, NULL },
   { "MultiPV", OPT_TYPE_SPIN, 1, 1, 500, NULL, NULL, 0, NULL },
   { "Skill Level", OPT_TYPE_SPIN, 20, 0, 20, NULL, NULL, 0, NULL },
   { "Move Overhead", OPT_TYPE_SPIN, 10, 0, 5000, NULL, NULL, 0, NULL },
+  { "Auto Move Overhead", OPT_TYPE_CHECK, 0, 0, 0, NULL, NULL, 0, NULL },
+  { "PV Reuse Depth", OPT_TYPE_SPIN, 0, 0, MAX_PLY, NULL, NULL, 0, NULL },
+  { "Spin Wait", OPT_TYPE_SPIN, 0, 0, 100000, NULL, NULL, 0, NULL }, // In us
   { "Slow Mover", OPT_TYPE_SPIN, 100, 10, 1000, NULL, NULL, 0, NULL },
   { "nodestime", OPT_TYPE_SPIN, 0, 0, 10000, NULL, NULL, 0, NULL },
   { "UCI_AnalyseMode", OPT_TYPE_CHECK, 0, 0, 0, NULL, NULL, 0, NULL },
   { "UCI_Chess960", OPT_TYPE_CHECK, 0, 0, 0, NULL, NULL, 0, NULL },
+  { "SyzygyPath", OPT_TYPE_STRING, 0, 0, 0, "<empty>", on_tb_path, 0, NULL },
+  { "SyzygyProbeDepth", OPT_TYPE_SPIN, 1, 1, 100, NULL, NULL, 0, NULL },
+  { "Syzygy50MoveRule", OPT_TYPE_CHECK, 1, 0, 0, NULL, NULL, 0, NULL },
+  { "SyzygyProbeLimit", OPT_TYPE_SPIN, 7, 0, 7, NULL, NULL, 0, NULL },
+  { "BookFile", OPT_TYPE_STRING, 0, 0, 0, "<empty>", on_book_file, 0, NULL },
+  { "BookFile2", OPT_TYPE_STRING, 0, 0, 0, "<empty>", on_book_file2, 0, NULL },
+  { "BestBookMove", OPT_TYPE_CHECK, 1, 0, 0, NULL, on_best_book_move, 0, NULL },
+  { "BookDepth", OPT_TYPE_SPIN, 255, 1, 255, NULL, on_book_depth, 0, NULL },
 #ifdef NNUE
   { "EvalFile", OPT_TYPE_STRING, 0, 0, 0, DefaultEvalFile, NULL, 0, NULL },
 #ifndef NNUE_PURE
@@ -119,7 +143,7 @@ static Option optionsMap[] = {
 #endif
 #endif
   { "LargePages", OPT_TYPE_CHECK, 1, 0, 0, NULL, on_large_pages, 0, NULL },
-  // { "NUMA", OPT_TYPE_STRING, 0, 0, 0, "all", on_numa, 0, NULL },
+  { "NUMA", OPT_TYPE_STRING, 0, 0, 0, "all", on_numa, 0, NULL },
   { 0 }
 };
 